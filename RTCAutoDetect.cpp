@@ -0,0 +1,146 @@
+// Detection of the RTC chip at 0x68 and a driver for whichever it is
+// Released to the public domain! Enjoy!
+
+#include <Wire.h>
+#include "RTCAutoDetect.h"
+
+#if defined(ARDUINO_SAM_DUE)
+#define Wire Wire1
+#endif
+
+#include "RTCInstrumentation.h"
+
+#ifdef RTCLIB_INSTRUMENT
+static RTC_WireProbe<TwoWire> rtc_wire(Wire);
+#undef Wire
+#define Wire rtc_wire
+#endif
+
+static uint8_t bcd2bin(uint8_t val) { return val - 6 * (val >> 4); }
+
+// True if the register file read from 0 repeats every `period` bytes,
+// comparing registers from `first` on with their copies
+static bool wraps_at(const uint8_t *regs, uint8_t period, uint8_t first = 0) {
+    for (uint8_t i = first + period; i < RTC_AUTO_BURST; ++i)
+        if (regs[i] != regs[i - period])
+            return false;
+    return true;
+}
+
+static bool read_burst(uint8_t *regs) {
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write((byte) 0);
+    if (Wire.endTransmission() != 0)
+        return false;
+    if (Wire.requestFrom(DS3231_ADDRESS, RTC_AUTO_BURST) != RTC_AUTO_BURST)
+        return false;
+    for (uint8_t i = 0; i < RTC_AUTO_BURST; ++i)
+        regs[i] = Wire.read();
+    return true;
+}
+
+static DateTime bcd_time(uint8_t ss, uint8_t mm, uint8_t hh, uint8_t d, uint8_t m, uint8_t y) {
+    return DateTime(bcd2bin(y) + 2000, bcd2bin(m & 0x1F), bcd2bin(d & 0x3F),
+                    bcd2bin(hh & 0x3F), bcd2bin(mm & 0x7F), bcd2bin(ss & 0x7F));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_Auto implementation
+
+/**
+ * @brief Identify the chip at 0x68 and read its state
+ *
+ * One pointer write and one RTC_AUTO_BURST byte read. The DS3231 latches
+ * its time registers again when the pointer wraps to 0, so if a second
+ * ticks during the read the two copies of the time differ. The registers
+ * that cannot change during a read (the alarms, 0x07 on) still wrap at
+ * 0x13 then, and the read is repeated once; the next tick is a second
+ * away. Writes nothing.
+ *
+ * @param result Set to the chip type, its power loss state and time
+ * @return False if nothing answered or the chip was not recognized
+ */
+bool RTC_Auto::probe(RtcProbeResult &result) {
+    RTC_PROBE(AUTO_PROBE);
+    result.type = RTC_CHIP_NONE;
+    result.lostPower = true;
+    result.now = DateTime((uint32_t) 0);
+
+    uint8_t r[RTC_AUTO_BURST];
+    if (!read_burst(r))
+        return false;
+    if (!wraps_at(r, DS3231_TEMP + 2) && wraps_at(r, DS3231_TEMP + 2, ALM1_SECONDS)) {
+        // a DS3231 that ticked, or by chance a DS1307 with RAM like that
+        if (!read_burst(r))
+            return false;
+    }
+
+    if (wraps_at(r, DS3231_TEMP + 2)) {
+        result.type = RTC_CHIP_DS3231;
+        result.lostPower = r[DS3231_STATUSREG] >> 7;
+        result.now = bcd_time(r[0], r[1], r[2], r[4], r[5], r[6]);
+    } else if (wraps_at(r, PCF8523_TIMER_B_VALUE + 1)) {
+        result.type = RTC_CHIP_PCF8523;
+        // OS flag, or battery switchover still in its reset state
+        result.lostPower = (r[3] >> 7) || (r[PCF8523_CONTROL_3] & 0xE0) == 0xE0;
+        result.now = bcd_time(r[3], r[4], r[5], r[6], r[8], r[9]);
+    } else if ((r[DS1307_CONTROL] & 0x6C) == 0) {
+        // bits 6, 5, 3 and 2 of the DS1307 control register read as 0
+        result.type = RTC_CHIP_DS1307;
+        result.lostPower = r[0] >> 7;   // CH, clock halted
+        result.now = bcd_time(r[0], r[1], r[2], r[4], r[5], r[6]);
+    } else {
+        result.type = RTC_CHIP_UNKNOWN;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Start the bus and detect the chip
+ *
+ * @param result Set as by probe(), saving the separate isrunning(),
+ * lostPower() or initialized() and now() calls at boot
+ * @return False if no known chip answered
+ */
+boolean RTC_Auto::begin(RtcProbeResult &result) {
+    Wire.begin();
+    probe(result);
+    _type = result.type;
+    return _type >= RTC_CHIP_DS1307;
+}
+
+/**
+ * @brief The time from the detected chip; DateTime(0) if there is none
+ */
+DateTime RTC_Auto::now() {
+    switch (_type) {
+    case RTC_CHIP_DS1307:
+        return _ds1307.now();
+    case RTC_CHIP_DS3231:
+        return _ds3231.now();
+    case RTC_CHIP_PCF8523:
+        return _pcf8523.now();
+    default:
+        return DateTime((uint32_t) 0);
+    }
+}
+
+/**
+ * @brief Set the detected chip's time
+ */
+void RTC_Auto::adjust(const DateTime &dt) {
+    switch (_type) {
+    case RTC_CHIP_DS1307:
+        _ds1307.adjust(dt);
+        break;
+    case RTC_CHIP_DS3231:
+        _ds3231.adjust(dt);
+        break;
+    case RTC_CHIP_PCF8523:
+        _pcf8523.adjust(dt);
+        break;
+    default:
+        break;
+    }
+}
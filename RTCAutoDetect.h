@@ -0,0 +1,87 @@
+// Detection of the RTC chip at 0x68 and a driver for whichever it is
+// Released to the public domain! Enjoy!
+//
+// The DS1307, DS3231 and PCF8523 share an address, but their register
+// pointers wrap at different places: the DS3231 after 0x12, the PCF8523
+// after 0x13 and the DS1307 only after its RAM at 0x3F. One 32 byte read
+// from register 0 therefore shows which chip answered, and holds its time
+// and oscillator status too, so a cold boot needs two bus transactions (four
+// if a second ticks during the read and it has to be repeated):
+//
+//   RTC_Auto rtc;
+//   RtcProbeResult boot;
+//   if (rtc.begin(boot) && boot.lostPower)
+//       rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
+//   DateTime t = rtc.now();     // calls RTC_DS3231::now() etc. via a switch
+
+#ifndef _RTC_AUTO_DETECT_H_
+#define _RTC_AUTO_DETECT_H_
+
+#include "RTClibExtended.h"
+
+// Bytes read by probe(); two wraps of the DS3231 map need at least 32
+#define RTC_AUTO_BURST               32
+
+enum RtcChipType { RTC_CHIP_NONE = 0, RTC_CHIP_UNKNOWN, RTC_CHIP_DS1307, RTC_CHIP_DS3231, RTC_CHIP_PCF8523 };
+
+struct RtcProbeResult {
+    RtcChipType type;
+    bool lostPower;         // oscillator stopped or time never set
+    DateTime now;           // only valid if type is a known chip
+};
+
+// Forwards to the detected chip's class. Every call is a switch on the
+// type and a direct (inlinable) call, no virtual functions.
+class RTC_Auto {
+public:
+    RTC_Auto() : _type(RTC_CHIP_NONE) {}
+
+    boolean begin(void)                 { RtcProbeResult r; return begin(r); }
+    boolean begin(RtcProbeResult& result);
+    static bool probe(RtcProbeResult& result);
+
+    RtcChipType type() const            { return _type; }
+    DateTime now();
+    void adjust(const DateTime& dt);
+
+    template <class F> bool dispatch(F& f);
+
+protected:
+    RtcChipType _type;
+    RTC_DS1307 _ds1307;
+    RTC_DS3231 _ds3231;
+    RTC_PCF8523 _pcf8523;
+};
+
+/**
+ * @brief Call f with the driver of the detected chip
+ *
+ * For chip specific work without knowing the chip at compile time:
+ *
+ *   struct SqwOff {
+ *       void operator()(RTC_DS1307& rtc)  { rtc.writeSqwPinMode(OFF); }
+ *       void operator()(RTC_DS3231& rtc)  { rtc.writeSqwPinMode(DS3231_OFF); }
+ *       void operator()(RTC_PCF8523& rtc) { rtc.writeSqwPinMode(PCF8523_OFF); }
+ *   } off;
+ *   rtc.dispatch(off);
+ *
+ * @return False if no known chip was detected
+ */
+template <class F>
+bool RTC_Auto::dispatch(F &f) {
+    switch (_type) {
+    case RTC_CHIP_DS1307:
+        f(_ds1307);
+        return true;
+    case RTC_CHIP_DS3231:
+        f(_ds3231);
+        return true;
+    case RTC_CHIP_PCF8523:
+        f(_pcf8523);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif // _RTC_AUTO_DETECT_H_
@@ -0,0 +1,222 @@
+// Aging offset calibration for the DS3231
+// Released to the public domain! Enjoy!
+
+#include "RTCCalibration.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_DS3231_Calibrator implementation
+
+RTC_DS3231_Calibrator::RTC_DS3231_Calibrator(int8_t agingOffset) {
+    reset(agingOffset);
+}
+
+/**
+ * @brief Drop all samples
+ *
+ * Call this whenever the aging offset changes or the RTC is adjusted, since
+ * older samples were taken against a different oscillator frequency or time.
+ *
+ * @param agingOffset The aging offset now in effect
+ */
+void RTC_DS3231_Calibrator::reset(int8_t agingOffset) {
+    memset(&_state, 0, sizeof(_state));
+    _state.magic = DS3231_CAL_MAGIC;
+    _state.agingOffset = agingOffset;
+}
+
+/**
+ * @brief Log one comparison between the RTC and a reference clock
+ *
+ * When the buffer is full the oldest sample is overwritten. The RTC only
+ * counts whole seconds, so a reading taken at an unknown point within its
+ * second is up to a second off, which no fit over days can average out.
+ * Either take the sample on the seconds tick (see sampleAtTick(), or read
+ * the RTC on the 1Hz SQW edge) or pass the time since the tick as rtcMs.
+ *
+ * @param reference Reference time, seconds since 1/1/1970
+ * @param rtc RTC time read at the same instant, seconds since 1/1/1970
+ * @param tempQuarter DS3231 temperature in quarter degrees C
+ * @param referenceMs Sub-second part of the reference time, 0..999
+ * @param rtcMs Time since the RTC seconds tick, 0..999; 0 on the tick
+ */
+void RTC_DS3231_Calibrator::addSample(uint32_t reference, uint32_t rtc, int16_t tempQuarter, int16_t referenceMs,
+                                      int16_t rtcMs) {
+    Ds3231CalSample &s = _state.samples[_state.head];
+    s.reference = reference;
+    s.offsetMs = (int32_t) (rtc - reference) * 1000L + rtcMs - referenceMs;
+    s.tempQuarter = tempQuarter;
+
+    _state.head = (_state.head + 1) % DS3231_CAL_SAMPLES;
+    if (_state.count < DS3231_CAL_SAMPLES)
+        ++_state.count;
+}
+
+void RTC_DS3231_Calibrator::addSample(const DateTime &reference, const DateTime &rtc, float temp, int16_t referenceMs,
+                                      int16_t rtcMs) {
+    int16_t q = (int16_t) (temp * 4 + (temp < 0 ? -0.5 : 0.5));
+    addSample(reference.unixtime(), rtc.unixtime(), q, referenceMs, rtcMs);
+}
+
+/**
+ * @brief Take a sample on the next RTC seconds tick
+ *
+ * Polls the seconds register every DS3231_CAL_POLL_US until it changes,
+ * then asks for the reference time and reads the RTC time and temperature.
+ * The sample lands within a poll interval and one register read of the
+ * tick; a constant delay cancels out of the fit.
+ *
+ * @param rtc The clock being calibrated
+ * @param reference Called right after the tick; sets the reference time in
+ * whole seconds since 1/1/1970 and its sub-second part in ms, or returns
+ * false if it has none
+ * @return False if no tick was seen within DS3231_PPS_TIMEOUT_MS or the
+ * reference failed
+ */
+bool RTC_DS3231_Calibrator::sampleAtTick(RTC_DS3231 &rtc, bool (*reference)(uint32_t &unixtime, int16_t &ms)) {
+    uint8_t ss = rtc.read(0x00);
+    uint32_t start = millis();
+    while (rtc.read(0x00) == ss) {
+        if (millis() - start > DS3231_PPS_TIMEOUT_MS)
+            return false;
+        delayMicroseconds(DS3231_CAL_POLL_US);
+    }
+
+    uint32_t ref;
+    int16_t refMs;
+    if (!reference(ref, refMs))
+        return false;
+    addSample(DateTime(ref), rtc.now(), rtc.getTemp(), refMs);
+    return true;
+}
+
+// i = 0 is the oldest sample
+const Ds3231CalSample &RTC_DS3231_Calibrator::sample(uint8_t i) const {
+    uint8_t first = (_state.head + DS3231_CAL_SAMPLES - _state.count) % DS3231_CAL_SAMPLES;
+    return _state.samples[(first + i) % DS3231_CAL_SAMPLES];
+}
+
+int16_t RTC_DS3231_Calibrator::meanTempQuarter() const {
+    if (_state.count == 0)
+        return 0;
+    int32_t sum = 0;
+    for (uint8_t i = 0; i < _state.count; ++i)
+        sum += sample(i).tempQuarter;
+    return sum / _state.count;
+}
+
+/**
+ * @brief Least-squares estimate of the RTC frequency error
+ *
+ * Fits offset = a + b * reference over the logged samples. The slope b, in
+ * milliseconds per second, is the frequency error in parts per thousand.
+ * Times are taken relative to the oldest sample so that single precision
+ * floats (all AVR has) keep enough resolution.
+ *
+ * @param ppm Set to the frequency error, positive if the RTC runs fast
+ * @return False if there are fewer than two samples or they span less than
+ * DS3231_CAL_MIN_SPAN seconds
+ */
+bool RTC_DS3231_Calibrator::estimate(float &ppm) const {
+    if (_state.count < 2)
+        return false;
+
+    const Ds3231CalSample &first = sample(0);
+    if ((int32_t) (sample(_state.count - 1).reference - first.reference) < DS3231_CAL_MIN_SPAN)
+        return false;
+
+    float mx = 0, my = 0;
+    for (uint8_t i = 0; i < _state.count; ++i) {
+        mx += (float) (sample(i).reference - first.reference);
+        my += (float) (sample(i).offsetMs - first.offsetMs);
+    }
+    mx /= _state.count;
+    my /= _state.count;
+
+    float sxx = 0, sxy = 0;
+    for (uint8_t i = 0; i < _state.count; ++i) {
+        float dx = (float) (sample(i).reference - first.reference) - mx;
+        float dy = (float) (sample(i).offsetMs - first.offsetMs) - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx <= 0)
+        return false;
+
+    ppm = sxy / sxx * 1000.0;
+    return true;
+}
+
+/**
+ * @brief The aging offset that would cancel the estimated frequency error
+ *
+ * @param offset Set to the new aging offset, clamped to -128..127
+ * @return False if no estimate is available yet
+ */
+bool RTC_DS3231_Calibrator::suggestedAgingOffset(int8_t &offset) const {
+    float ppm;
+    if (!estimate(ppm))
+        return false;
+
+    // A fast clock needs more load capacitance, i.e. a larger offset
+    float trim = ppm * DS3231_CAL_LSB_PER_PPM;
+    int16_t value = _state.agingOffset + (int16_t) (trim + (trim < 0 ? -0.5 : 0.5));
+    if (value > 127)
+        value = 127;
+    if (value < -128)
+        value = -128;
+    offset = value;
+    return true;
+}
+
+/**
+ * @brief Write the suggested aging offset to the DS3231
+ *
+ * Forces a temperature conversion so the new offset takes effect now and
+ * starts a fresh set of samples for the new oscillator frequency.
+ *
+ * @param rtc The clock to trim
+ * @return True if the aging offset register was changed
+ */
+bool RTC_DS3231_Calibrator::apply(RTC_DS3231 &rtc) {
+    int8_t offset;
+    if (!suggestedAgingOffset(offset) || offset == _state.agingOffset)
+        return false;
+
+    rtc.setAgingOffset(offset);
+    rtc.forceConversion();
+    reset(offset);
+    return true;
+}
+
+/**
+ * @brief The calibration state, ready to be saved
+ * @see restore
+ */
+const Ds3231CalState &RTC_DS3231_Calibrator::state() {
+    _state.checksum = checksum(_state);
+    return _state;
+}
+
+/**
+ * @brief Reload a state saved with state()
+ *
+ * @param state The saved state
+ * @return False, leaving the calibrator unchanged, if the state is not valid
+ * (e.g. erased EEPROM or a different DS3231_CAL_SAMPLES)
+ */
+bool RTC_DS3231_Calibrator::restore(const Ds3231CalState &state) {
+    if (state.magic != DS3231_CAL_MAGIC || state.checksum != checksum(state)
+        || state.count > DS3231_CAL_SAMPLES || state.head >= DS3231_CAL_SAMPLES)
+        return false;
+
+    _state = state;
+    return true;
+}
+
+uint8_t RTC_DS3231_Calibrator::checksum(const Ds3231CalState &state) {
+    const uint8_t *p = (const uint8_t *) &state;
+    uint8_t sum = DS3231_CAL_SAMPLES;
+    for (size_t i = 0; i < offsetof(Ds3231CalState, checksum); ++i)
+        sum = (sum << 1 | sum >> 7) ^ p[i];
+    return sum;
+}
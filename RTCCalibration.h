@@ -0,0 +1,80 @@
+// Aging offset calibration for the DS3231
+// Released to the public domain! Enjoy!
+
+#ifndef _RTC_CALIBRATION_H_
+#define _RTC_CALIBRATION_H_
+
+#include "RTClibExtended.h"
+
+// Number of (reference, rtc, temperature) samples kept for the drift fit.
+// Each sample costs 10 bytes of RAM; override before including if needed.
+#ifndef DS3231_CAL_SAMPLES
+#define DS3231_CAL_SAMPLES           8
+#endif
+
+// Shortest span of reference time (seconds) that the fit will be trusted on.
+// With samples on the seconds tick, 1 ms of timing error is 0.012 ppm over
+// a day, and a day averages out the daily temperature swing.
+#ifndef DS3231_CAL_MIN_SPAN
+#define DS3231_CAL_MIN_SPAN          86400L
+#endif
+
+// Poll interval of sampleAtTick() while it waits for the seconds tick
+#ifndef DS3231_CAL_POLL_US
+#define DS3231_CAL_POLL_US           250
+#endif
+
+// Aging offset change per ppm of frequency error (datasheet: ~0.1 ppm/LSB)
+#define DS3231_CAL_LSB_PER_PPM       10
+
+#define DS3231_CAL_MAGIC             0xCA
+
+struct Ds3231CalSample {
+    uint32_t reference;     // reference (true) time, seconds since 1/1/1970
+    int32_t offsetMs;       // RTC minus reference, milliseconds
+    int16_t tempQuarter;    // DS3231 temperature, quarter degrees C
+};
+
+// Everything the calibrator knows; plain data so a sketch can keep it in
+// EEPROM (EEPROM.put / EEPROM.get) and restore it after a reset.
+struct Ds3231CalState {
+    uint8_t magic;
+    uint8_t head;
+    uint8_t count;
+    int8_t agingOffset;     // aging offset in effect while samples were taken
+    Ds3231CalSample samples[DS3231_CAL_SAMPLES];
+    uint8_t checksum;
+};
+
+// Estimates the DS3231 frequency error from pairs of reference and RTC times
+// with a least-squares fit and trims the aging offset register to cancel it.
+// The estimator does not touch the bus, only apply() does.
+class RTC_DS3231_Calibrator {
+public:
+    RTC_DS3231_Calibrator(int8_t agingOffset = 0);
+
+    void reset(int8_t agingOffset);
+    void addSample(uint32_t reference, uint32_t rtc, int16_t tempQuarter, int16_t referenceMs = 0, int16_t rtcMs = 0);
+    void addSample(const DateTime& reference, const DateTime& rtc, float temp, int16_t referenceMs = 0, int16_t rtcMs = 0);
+    bool sampleAtTick(RTC_DS3231& rtc, bool (*reference)(uint32_t& unixtime, int16_t& ms));
+
+    uint8_t count() const       { return _state.count; }
+    int8_t agingOffset() const  { return _state.agingOffset; }
+    int16_t meanTempQuarter() const;
+
+    // Frequency error in ppm, positive when the RTC runs fast
+    bool estimate(float& ppm) const;
+    bool suggestedAgingOffset(int8_t& offset) const;
+    bool apply(RTC_DS3231& rtc);
+
+    const Ds3231CalState& state();
+    bool restore(const Ds3231CalState& state);
+
+protected:
+    static uint8_t checksum(const Ds3231CalState& state);
+    const Ds3231CalSample& sample(uint8_t i) const;
+
+    Ds3231CalState _state;
+};
+
+#endif // _RTC_CALIBRATION_H_
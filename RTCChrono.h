@@ -0,0 +1,80 @@
+// std::chrono clocks for the RTC library
+// Released to the public domain! Enjoy!
+//
+// On platforms with <chrono> (ESP32, host builds, ...) every RTC class with a
+// static now() can be used as a std::chrono TrivialClock:
+//
+//   RTC_DS3231_Clock::time_point t = RTC_DS3231_Clock::now();
+//   std::chrono::system_clock::time_point s = rtcToSys(t);
+//   t = rtcFromSys<RTC_DS3231>(s);
+//
+// Times count seconds since 1/1/1970 like DateTime::unixtime(), so the
+// conversions below are a single integer copy. On AVR this header is empty.
+
+#ifndef _RTC_CHRONO_H_
+#define _RTC_CHRONO_H_
+
+#include "RTClibExtended.h"
+
+#if defined(__has_include)
+#if __has_include(<chrono>)
+#define RTCLIB_HAS_CHRONO
+#endif
+#endif
+
+#ifdef RTCLIB_HAS_CHRONO
+
+#include <chrono>
+
+template <class RTC>
+struct RTC_Clock {
+    typedef std::chrono::seconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<RTC_Clock> time_point;
+    static constexpr bool is_steady = false;
+
+    static time_point now() noexcept { return fromDateTime(RTC::now()); }
+
+    static time_point fromDateTime(const DateTime& dt) noexcept {
+        return time_point(duration(dt.unixtime()));
+    }
+    static DateTime toDateTime(const time_point& t) noexcept {
+        return DateTime((uint32_t) t.time_since_epoch().count());
+    }
+};
+
+template <class RTC>
+constexpr bool RTC_Clock<RTC>::is_steady;
+
+typedef RTC_Clock<RTC_DS1307> RTC_DS1307_Clock;
+typedef RTC_Clock<RTC_DS3231> RTC_DS3231_Clock;
+typedef RTC_Clock<RTC_PCF8523> RTC_PCF8523_Clock;
+typedef RTC_Clock<RTC_Millis> RTC_Millis_Clock;
+
+inline std::chrono::seconds toDuration(const TimeSpan& span) noexcept {
+    return std::chrono::seconds(span.totalseconds());
+}
+
+template <class Rep, class Period>
+inline TimeSpan toTimeSpan(const std::chrono::duration<Rep, Period>& d) noexcept {
+    return TimeSpan((int32_t) std::chrono::duration_cast<std::chrono::seconds>(d).count());
+}
+
+// system_clock counts from 1/1/1970 on every platform that matters (and
+// is required to since C++20), so only the representation changes
+template <class RTC>
+inline std::chrono::system_clock::time_point rtcToSys(const std::chrono::time_point<RTC_Clock<RTC> >& t) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(t.time_since_epoch()));
+}
+
+template <class RTC>
+inline typename RTC_Clock<RTC>::time_point rtcFromSys(const std::chrono::system_clock::time_point& t) {
+    return typename RTC_Clock<RTC>::time_point(
+        std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()));
+}
+
+#endif // RTCLIB_HAS_CHRONO
+
+#endif // _RTC_CHRONO_H_
@@ -0,0 +1,360 @@
+// Battery drain estimates for RTC configurations, for host builds
+// Released to the public domain! Enjoy!
+
+#include "RTCEnergyModel.h"
+
+// standby, battery, bus, conversion uA, conversion ms
+const RtcPowerProfile RTC_POWER_DS1307 = { 200, 0.3, 1300, 0, 0 };        // 5V only
+const RtcPowerProfile RTC_POWER_DS3231 = { 110, 0.84, 90, 575, 125 };
+const RtcPowerProfile RTC_POWER_PCF8523 = { 0.15, 0.15, 50, 0, 0 };
+
+static const __FlashStringHelper *cause_name(uint8_t cause) {
+    switch (cause) {
+    case RTC_ENERGY_TIMEKEEPING:
+        return F("timekeeping");
+    case RTC_ENERGY_BUS:
+        return F("bus");
+    case RTC_ENERGY_CONVERSION:
+        return F("conversion");
+    case RTC_ENERGY_32KHZ:
+        return F("32kHz");
+    case RTC_ENERGY_SQW:
+        return F("sqw");
+    default:
+        return F("alarm");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_EnergyModel implementation
+//
+// Charges are kept in microcoulomb (uA * s). An open-drain output toggling
+// at a 50% duty cycle costs half the pull-up current plus C * V * f for its
+// load; SDA and SCL are each taken as low half the time while the bus runs.
+
+RTC_EnergyModel::RTC_EnergyModel(const RtcPowerProfile &chip, const RtcBoardProfile &board) :
+        _chip(chip),
+        _board(board) {
+    reset();
+}
+
+/**
+ * @brief Zero the charges and elapsed time and turn the outputs off
+ */
+void RTC_EnergyModel::reset() {
+    _clkHz = 0;
+    _sqwHz = 0;
+    _sqwLow = false;
+    _elapsed = 0;
+    for (uint8_t i = 0; i < RTC_ENERGY_CAUSES; ++i)
+        _charge[i] = 0;
+}
+
+float RTC_EnergyModel::outputUa(float hz, float pullupOhms) const {
+    if (hz <= 0 || pullupOhms <= 0)
+        return 0;
+    return _board.volts / pullupOhms * 0.5e6 + _board.loadPf * 1e-6 * _board.volts * hz;
+}
+
+/**
+ * @brief Charge one transaction
+ *
+ * @param bytes Bytes on the bus including the address byte
+ */
+void RTC_EnergyModel::busTransaction(uint8_t bytes) {
+    busTraffic(1, bytes);
+}
+
+/**
+ * @brief Charge a number of transactions, e.g. from RTC_Instrumentation
+ *
+ * @param transactions Start conditions
+ * @param bytes Bytes on the bus including the address bytes
+ */
+void RTC_EnergyModel::busTraffic(uint32_t transactions, uint32_t bytes) {
+    // 9 clocks per byte with the acknowledge, about 2 for start and stop
+    busActive((bytes * 9 + transactions * 2) / _board.busKHz);
+}
+
+/**
+ * @brief Charge the bus running for ms milliseconds
+ */
+void RTC_EnergyModel::busActive(float ms) {
+    float ua = _chip.busUa;
+    if (_board.busPullupOhms > 0)
+        ua += _board.volts / _board.busPullupOhms * 1e6;
+    _charge[RTC_ENERGY_BUS] += ua * ms / 1000;
+}
+
+/**
+ * @brief Charge one forced temperature conversion
+ */
+void RTC_EnergyModel::conversion() {
+    _charge[RTC_ENERGY_CONVERSION] += _chip.conversionUa * _chip.conversionMs / 1000;
+}
+
+/**
+ * @brief Charge one alarm wakeup of the MCU
+ */
+void RTC_EnergyModel::wakeup() {
+    _charge[RTC_ENERGY_ALARM] += _board.wakeUc;
+}
+
+/**
+ * @brief Let time pass in the current state
+ */
+void RTC_EnergyModel::advance(uint32_t seconds) {
+    _charge[RTC_ENERGY_TIMEKEEPING] += (double) (_board.rtcOnBattery ? _chip.batteryUa : _chip.standbyUa) * seconds;
+    _charge[RTC_ENERGY_32KHZ] += (double) outputUa(_clkHz, _board.clkPullupOhms) * seconds;
+    if (_sqwLow) {
+        if (_board.sqwPullupOhms > 0)
+            _charge[RTC_ENERGY_ALARM] += (double) _board.volts / _board.sqwPullupOhms * 1e6 * seconds;
+    } else {
+        _charge[RTC_ENERGY_SQW] += (double) outputUa(_sqwHz, _board.sqwPullupOhms) * seconds;
+    }
+    _elapsed += seconds;
+}
+
+double RTC_EnergyModel::totalUc() const {
+    double total = 0;
+    for (uint8_t i = 0; i < RTC_ENERGY_CAUSES; ++i)
+        total += _charge[i];
+    return total;
+}
+
+/**
+ * @brief Average current over the elapsed time, in microampere
+ */
+float RTC_EnergyModel::averageUa() const {
+    return _elapsed ? totalUc() / _elapsed : 0;
+}
+
+/**
+ * @brief Days a battery would last at the average current
+ *
+ * @param mAh Usable capacity, e.g. 220 for a CR2032
+ */
+float RTC_EnergyModel::batteryDays(float mAh) const {
+    float ua = averageUa();
+    return ua > 0 ? mAh * 1000 / ua / 24 : 0;
+}
+
+/**
+ * @brief Print the charge per cause and the projection
+ *
+ * One line per cause: name, uAh, percentage of the total. Then the average
+ * current in uA and, given a capacity, the battery life in days.
+ *
+ * @param out Where to print
+ * @param batteryMah Battery capacity, 0 to skip the projection
+ */
+void RTC_EnergyModel::report(Print &out, float batteryMah) const {
+    double total = totalUc();
+    for (uint8_t i = 0; i < RTC_ENERGY_CAUSES; ++i) {
+        out.print(cause_name(i));
+        out.print(' ');
+        out.print(_charge[i] / 3600, 3);
+        out.print(F(" uAh "));
+        out.print(total > 0 ? _charge[i] * 100 / total : 0, 1);
+        out.println('%');
+    }
+    out.print(F("average uA "));
+    out.println(averageUa(), 3);
+    if (batteryMah > 0) {
+        out.print(F("battery days "));
+        out.println(batteryDays(batteryMah), 0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_DS3231_Sim implementation
+//
+// Bus costs follow RTC_DS3231: a register read-modify-write is 3
+// transactions of 7 bytes in all, and the alarm helpers add a stray
+// endTransmission(). forceConversion() polls the busy bit without delay, so
+// the bus runs for the whole conversion.
+
+RTC_DS3231_Sim::RTC_DS3231_Sim(RTC_EnergyModel &model, const DateTime &start) :
+        _model(model),
+        _time(start.unixtime()),
+        _set(0),
+        _armed(0),
+        _flags(0),
+        _en32kHz(true),
+        _bbsqw(false),
+        _intcn(true),
+        _sqw(DS3231_OFF) {
+    update();
+}
+
+// Push the output state into the model
+void RTC_DS3231_Sim::update() {
+    _model.setClockOutHz(_en32kHz ? 32768 : 0);
+    float hz = 0;
+    if (outputsOn() && !_intcn) {
+        switch (_sqw) {
+        case DS3231_SquareWave1Hz:
+            hz = 1;
+            break;
+        case DS3231_SquareWave1kHz:
+            hz = 1024;
+            break;
+        case DS3231_SquareWave4kHz:
+            hz = 4096;
+            break;
+        case DS3231_SquareWave8kHz:
+            hz = 8192;
+            break;
+        default:
+            break;
+        }
+    }
+    _model.setSqwHz(hz);
+    _model.setSqwLow(intLow());
+}
+
+void RTC_DS3231_Sim::adjust(const DateTime &dt) {
+    _model.busTransaction(9);
+    rmw();
+    _time = dt.unixtime();
+}
+
+bool RTC_DS3231_Sim::lostPower(void) {
+    _model.busTraffic(2, 4);
+    return false;
+}
+
+DateTime RTC_DS3231_Sim::now() {
+    _model.busTraffic(2, 10);
+    return DateTime(_time);
+}
+
+void RTC_DS3231_Sim::writeSqwPinMode(Ds3231SqwPinMode mode) {
+    rmw();
+    _sqw = mode;
+    _intcn = mode == DS3231_OFF;
+    update();
+}
+
+float RTC_DS3231_Sim::getTemp() {
+    _model.busTraffic(3, 6);
+    return 25.0;
+}
+
+byte RTC_DS3231_Sim::setEN32kHz(bool enable) {
+    rmw();
+    _en32kHz = enable;
+    update();
+    return enable ? DS3231_EN32kHz : 0;
+}
+
+byte RTC_DS3231_Sim::setBBSQW(bool enable) {
+    rmw();
+    _bbsqw = enable;
+    update();
+    return (enable ? DS3231_BBSQW : 0) | (_intcn ? DS3231_INTCN : 0);
+}
+
+void RTC_DS3231_Sim::forceConversion(void) {
+    _model.busTraffic(4, 8);
+    _model.busActive(_model.chip().conversionMs);
+    _model.conversion();
+}
+
+/**
+ * @brief Set, arm and clear an alarm, as RTC_DS3231::setAlarm() does
+ */
+void RTC_DS3231_Sim::setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate) {
+    uint8_t i = alarmType & 0x80 ? 1 : 0;
+    _alarm[i].set(alarmType, seconds, minutes, hours, daydate);
+    _set |= 1 << i;
+    if (i)
+        _model.busTraffic(3, 9);
+    else
+        _model.busTraffic(4, 12);
+    _model.busTraffic(8, 16);
+    _armed |= 1 << i;
+    _flags &= ~(1 << i);
+    update();
+}
+
+void RTC_DS3231_Sim::armAlarm(byte alarmNumber, bool armed) {
+    _model.busTraffic(4, 8);
+    uint8_t mask = 1 << (alarmNumber == 2 ? 1 : 0);
+    if (armed)
+        _armed |= mask;
+    else
+        _armed &= ~mask;
+    update();
+}
+
+void RTC_DS3231_Sim::clearAlarm(byte alarmNumber) {
+    _model.busTraffic(4, 8);
+    _flags &= ~(1 << (alarmNumber == 2 ? 1 : 0));
+    update();
+}
+
+/**
+ * @brief Read the control or status register, e.g. to poll an alarm flag
+ *
+ * @return The register bits the model keeps; 0 for other registers
+ */
+byte RTC_DS3231_Sim::read(byte addr) {
+    _model.busTraffic(2, 4);
+    switch (addr) {
+    case DS3231_CONTROL:
+        return (_bbsqw ? DS3231_BBSQW : 0) | (_intcn ? DS3231_INTCN : 0) | _armed;
+    case DS3231_STATUSREG:
+        return (_en32kHz ? DS3231_EN32kHz : 0) | _flags;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Let simulated time pass, firing the alarms
+ *
+ * The time jumps from one alarm match to the next, so sparse alarms cost
+ * nothing to simulate. As on the chip, a match sets the alarm flag whether
+ * or not the alarm is armed; arming it later with the flag set pulls INT
+ * low at once. A match asserts INT, and wakes the firmware by calling
+ * onAlarm, only if the alarm is armed, INT was released and can be driven
+ * (INTCN set, and on battery BBSQW set); an alarm flag that is never
+ * cleared keeps INT low, drawing pull-up current, and no later alarm gets
+ * through.
+ *
+ * @param seconds How long to run
+ * @param onAlarm Called at each wakeup with the alarm number; it may call
+ * the methods above but not run()
+ */
+void RTC_DS3231_Sim::run(uint32_t seconds, AlarmHandler onAlarm) {
+    uint32_t end = _time + seconds;
+    while (_time < end) {
+        uint32_t next = end, match;
+        bool due = false;
+        for (uint8_t i = 0; i < 2; ++i) {
+            if ((_set & (1 << i)) && _alarm[i].next(_time, match) && match <= next) {
+                next = match;
+                due = true;
+            }
+        }
+
+        _model.advance(next - _time);
+        _time = next;
+        if (!due)
+            break;
+
+        for (uint8_t i = 0; i < 2; ++i) {
+            if (!(_set & (1 << i)) || !_alarm[i].next(_time - 1, match) || match != _time)
+                continue;
+            bool wakes = (_armed & (1 << i)) && !intLow() && outputsOn() && _intcn;
+            _flags |= 1 << i;
+            update();
+            if (wakes) {
+                _model.wakeup();
+                if (onAlarm)
+                    onAlarm(*this, i + 1);
+            }
+        }
+    }
+}
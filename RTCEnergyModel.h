@@ -0,0 +1,155 @@
+// Battery drain estimates for RTC configurations, for host builds
+// Released to the public domain! Enjoy!
+//
+// RTC_EnergyModel integrates the current drawn by an RTC chip and the lines
+// around it, split by cause: timekeeping, bus traffic, forced temperature
+// conversions, the 32kHz output, the square wave output and alarm wakeups.
+// RTC_DS3231_Sim has the configuration and alarm calls of RTC_DS3231 and
+// charges the model for each one, with the bus transactions the real method
+// makes, while run() moves a simulated clock forward. Firmware logic that is
+// written against the RTC class as a template parameter can be replayed over
+// a simulated year in well under a second:
+//
+//   RTC_EnergyModel model(RTC_POWER_DS3231);
+//   RTC_DS3231_Sim rtc(model);
+//   rtc.setEN32kHz(false);
+//   rtc.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+//   rtc.armAlarm(2, true);
+//   rtc.run(365 * 86400L, onAlarm);       // onAlarm reads the time, clears the flag
+//   model.report(out, 220);               // CR2032
+//
+// The chip figures are typical datasheet values at 3.3V (5V for the DS1307);
+// replace them with measurements of your own board where you have them.
+
+#ifndef _RTC_ENERGY_MODEL_H_
+#define _RTC_ENERGY_MODEL_H_
+
+#include "RTClibExtended.h"
+#include "RTCSoftAlarm.h"
+
+struct RtcPowerProfile {
+    float standbyUa;        // on Vcc, bus idle, automatic conversions included
+    float batteryUa;        // on Vbat, oscillator running
+    float busUa;            // extra while the bus is active
+    float conversionUa;     // extra during a forced temperature conversion
+    float conversionMs;
+};
+
+extern const RtcPowerProfile RTC_POWER_DS1307;
+extern const RtcPowerProfile RTC_POWER_DS3231;
+extern const RtcPowerProfile RTC_POWER_PCF8523;
+
+// The board around the chip; a pull-up of 0 means none is fitted
+struct RtcBoardProfile {
+    RtcBoardProfile() : volts(3.3), busKHz(100), busPullupOhms(4700), clkPullupOhms(0),
+                        sqwPullupOhms(10000), loadPf(15), wakeUc(0), rtcOnBattery(false) {}
+
+    float volts;
+    float busKHz;
+    float busPullupOhms;    // SDA and SCL
+    float clkPullupOhms;    // 32kHz / CLKOUT pin
+    float sqwPullupOhms;    // SQW / INT pin
+    float loadPf;           // capacitance on each output
+    float wakeUc;           // MCU charge per alarm wakeup, microcoulomb
+    bool rtcOnBattery;      // Vcc switched off between accesses, chip runs from Vbat
+};
+
+enum RtcEnergyCause {
+    RTC_ENERGY_TIMEKEEPING = 0,
+    RTC_ENERGY_BUS,
+    RTC_ENERGY_CONVERSION,
+    RTC_ENERGY_32KHZ,
+    RTC_ENERGY_SQW,
+    RTC_ENERGY_ALARM,
+    RTC_ENERGY_CAUSES
+};
+
+class RTC_EnergyModel {
+public:
+    RTC_EnergyModel(const RtcPowerProfile& chip, const RtcBoardProfile& board = RtcBoardProfile());
+
+    void reset();
+    const RtcPowerProfile& chip() const     { return _chip; }
+    const RtcBoardProfile& board() const    { return _board; }
+
+    // Steady state of the outputs; frequencies in Hz, 0 for off
+    void setClockOutHz(float hz)            { _clkHz = hz; }
+    void setSqwHz(float hz)                 { _sqwHz = hz; }
+    void setSqwLow(bool low)                { _sqwLow = low; }
+
+    // Events
+    void busTransaction(uint8_t bytes);
+    void busTraffic(uint32_t transactions, uint32_t bytes);
+    void busActive(float ms);
+    void conversion();
+    void wakeup();
+    void advance(uint32_t seconds);
+
+    double chargeUc(RtcEnergyCause cause) const { return _charge[cause]; }
+    double totalUc() const;
+    uint32_t elapsed() const                { return _elapsed; }
+    float averageUa() const;
+    float batteryDays(float mAh) const;
+    void report(Print& out, float batteryMah = 0) const;
+
+protected:
+    float outputUa(float hz, float pullupOhms) const;
+
+    RtcPowerProfile _chip;
+    RtcBoardProfile _board;
+    float _clkHz;
+    float _sqwHz;
+    bool _sqwLow;           // SQW/INT held low, e.g. by an uncleared alarm
+    uint32_t _elapsed;
+    double _charge[RTC_ENERGY_CAUSES];
+};
+
+// A DS3231 that exists only as a model: the calls below mirror RTC_DS3231,
+// keep the register state that matters for power, and charge the bus
+// traffic of the real implementation. The state starts as after power-up:
+// 32kHz output on, INTCN set, BBSQW clear.
+class RTC_DS3231_Sim {
+public:
+    typedef void (*AlarmHandler)(RTC_DS3231_Sim& rtc, byte alarmNumber);
+
+    RTC_DS3231_Sim(RTC_EnergyModel& model, const DateTime& start = DateTime(2026, 1, 1, 0, 0, 0));
+
+    boolean begin(void)                     { return true; }
+    void adjust(const DateTime& dt);
+    bool lostPower(void);
+    DateTime now();
+    void writeSqwPinMode(Ds3231SqwPinMode mode);
+    float getTemp();
+    byte setEN32kHz(bool enable);
+    byte setBBSQW(bool enable);
+    void forceConversion(void);
+    void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate);
+    void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte minutes, byte hours, byte daydate) {
+        setAlarm(alarmType, 0, minutes, hours, daydate);
+    }
+    void armAlarm(byte alarmNumber, bool armed);
+    void clearAlarm(byte alarmNumber);
+    byte read(byte addr);
+
+    void run(uint32_t seconds, AlarmHandler onAlarm = 0);
+    uint32_t unixtime() const               { return _time; }
+
+protected:
+    void rmw()                              { _model.busTraffic(3, 7); }
+    bool outputsOn() const                  { return !_model.board().rtcOnBattery || _bbsqw; }
+    bool intLow() const                     { return outputsOn() && _intcn && (_flags & _armed); }
+    void update();
+
+    RTC_EnergyModel& _model;
+    uint32_t _time;
+    RTC_SoftAlarm _alarm[2];
+    uint8_t _set;               // alarms given a time, which set their flag
+    uint8_t _armed;
+    uint8_t _flags;
+    bool _en32kHz;
+    bool _bbsqw;
+    bool _intcn;
+    Ds3231SqwPinMode _sqw;
+};
+
+#endif // _RTC_ENERGY_MODEL_H_
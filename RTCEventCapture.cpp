@@ -0,0 +1,224 @@
+// Timestamping of external events from an interrupt handler
+// Released to the public domain! Enjoy!
+
+#include "RTCEventCapture.h"
+
+#ifdef __AVR__
+#define RTC_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define RTC_BARRIER() __sync_synchronize()
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_EventCapture implementation
+//
+// The ring indices are free running 8 bit counters, so they are read and
+// written atomically even on AVR. The ISR owns _head, loop() owns _tail; the
+// barriers order the slot access against publishing the index.
+
+/**
+ * @brief An empty, unanchored capture ring
+ *
+ * @param ticksPerSecond Rate of the tick values passed to capture(); the
+ * default suits micros()
+ */
+RTC_EventCapture::RTC_EventCapture(uint32_t ticksPerSecond) :
+        _head(0),
+        _overflows(0),
+        _edgeTicks(0),
+        _edges(0),
+        _edgeSeen(false),
+        _tail(0),
+        _nominal(ticksPerSecond),
+        _rate(ticksPerSecond),
+        _refUnix(0),
+        _refTicks(0),
+        _refEdge(0),
+        _anchored(false),
+        _edgeAnchored(false) {}
+
+/**
+ * @brief Record an event; call from the event ISR
+ *
+ * If the ring is full the event is dropped and counted in overflows().
+ *
+ * @param ticks Tick value at the event
+ */
+void RTC_EventCapture::capture(uint32_t ticks) {
+    uint8_t head = _head;
+    if ((uint8_t) (head - _tail) >= RTC_EVENT_RING) {
+        _overflows = _overflows + 1;
+        return;
+    }
+    _ring[head & (RTC_EVENT_RING - 1)] = ticks;
+    RTC_BARRIER();
+    _head = head + 1;
+}
+
+/**
+ * @brief Record the start of an RTC second; call from the 1Hz square wave ISR
+ *
+ * @param ticks Tick value at the falling edge
+ */
+void RTC_EventCapture::ppsEdge(uint32_t ticks) {
+    _edgeTicks = ticks;
+    _edges = _edges + 1;
+    _edgeSeen = true;
+}
+
+// A consistent copy of the edge counter and its tick value. On AVR the
+// reads below are not atomic; an edge in between changes _edges, and any
+// torn read of it differs from the second read, so retrying is enough.
+void RTC_EventCapture::lastEdge(uint16_t &edge, uint32_t &ticks) const {
+    do {
+        edge = _edges;
+        RTC_BARRIER();
+        ticks = _edgeTicks;
+        RTC_BARRIER();
+    } while (edge != _edges);
+}
+
+/**
+ * @brief Number of square wave edges seen, for anchorToEdge()
+ */
+uint16_t RTC_EventCapture::edges() const {
+    uint16_t edge;
+    uint32_t ticks;
+    lastEdge(edge, ticks);
+    return edge;
+}
+
+/**
+ * @brief Number of events dropped because the ring was full
+ *
+ * The counter is never reset (the ISR owns it); compare two readings.
+ */
+uint16_t RTC_EventCapture::overflows() const {
+    uint16_t n;
+    do {
+        n = _overflows;
+        RTC_BARRIER();
+    } while (n != _overflows);
+    return n;
+}
+
+/**
+ * @brief Anchor to a tick value read at a known time
+ *
+ * Without the square wave the anchor is only as good as the pairing of
+ * unixtime with ticks (up to a second with now()), and events drift with
+ * the tick source; re-anchor regularly.
+ *
+ * @param unixtime Seconds since 1/1/1970
+ * @param ticks Tick value at the start of that second
+ */
+void RTC_EventCapture::anchor(uint32_t unixtime, uint32_t ticks) {
+    _refUnix = unixtime;
+    _refTicks = ticks;
+    _rate = _nominal;
+    _anchored = true;
+    _edgeAnchored = false;
+}
+
+/**
+ * @brief Anchor to a square wave edge
+ *
+ * Every later edge moves the anchor one second on and measures the tick rate,
+ * so drift of the tick source cancels out.
+ *
+ * @param unixtime The RTC time, read after edge
+ * @param edge edges() before the RTC was read
+ * @return False if no edge has been seen or another edge arrived since
+ */
+bool RTC_EventCapture::anchorToEdge(uint32_t unixtime, uint16_t edge) {
+    uint16_t current;
+    uint32_t ticks;
+    lastEdge(current, ticks);
+    if (!_edgeSeen || current != edge)
+        return false;
+    _refUnix = unixtime;
+    _refTicks = ticks;
+    _refEdge = current;
+    _rate = _nominal;
+    _anchored = true;
+    _edgeAnchored = true;
+    return true;
+}
+
+// Move the anchor forward to the latest edge, or by whole seconds when it
+// gets close to half a tick wrap, so the signed differences in drain() hold
+void RTC_EventCapture::follow(uint32_t nowTicks) {
+    if (_edgeAnchored) {
+        uint16_t edge;
+        uint32_t ticks;
+        lastEdge(edge, ticks);
+        uint32_t seconds = (uint16_t) (edge - _refEdge);
+        if (seconds) {
+            // Unless the span may have wrapped, count the seconds in ticks,
+            // as a lost edge (noise, a long ISR) would put the edge count
+            // behind for good, and take the measured rate if it is within
+            // 1% of nominal
+            if (seconds <= 0x7FFFFFFFUL / _nominal) {
+                uint32_t span = ticks - _refTicks;
+                uint32_t counted = (span + _rate / 2) / _rate;
+                if (counted)
+                    seconds = counted;
+                uint32_t rate = span / seconds;
+                if (rate > _nominal - _nominal / 100 && rate < _nominal + _nominal / 100)
+                    _rate = rate;
+            }
+            _refUnix += seconds;
+            _refTicks = ticks;
+            _refEdge = edge;
+        }
+    }
+
+    uint32_t elapsed = nowTicks - _refTicks;
+    if (elapsed >= 0x40000000UL) {
+        uint32_t seconds = elapsed / _rate;
+        _refUnix += seconds;
+        _refTicks += seconds * _rate;
+    }
+}
+
+/**
+ * @brief Convert and remove up to max captured events, oldest first
+ *
+ * Nothing is removed until the capture is anchored.
+ *
+ * @param events Receives the converted events
+ * @param max Size of events
+ * @param nowTicks The current tick value
+ * @return Number of events written
+ */
+uint8_t RTC_EventCapture::drain(RtcEvent *events, uint8_t max, uint32_t nowTicks) {
+    if (!_anchored)
+        return 0;
+    follow(nowTicks);
+
+    uint8_t head = _head;
+    RTC_BARRIER();
+    uint8_t tail = _tail;
+    uint8_t n = 0;
+    int32_t rate = _rate;
+    while (tail != head && n < max) {
+        uint32_t ticks = _ring[tail & (RTC_EVENT_RING - 1)];
+        RTC_BARRIER();
+        _tail = ++tail;
+
+        // floor division, events may precede the anchor
+        int32_t diff = (int32_t) (ticks - _refTicks);
+        int32_t seconds = diff / rate;
+        int32_t rest = diff - seconds * rate;
+        if (rest < 0) {
+            --seconds;
+            rest += rate;
+        }
+        // rest * 1000 fits in 32 bits for any rate up to 4.29MHz
+        uint32_t ms = rate < 4294967L ? (uint32_t) rest * 1000 / rate : rest / (rate / 1000);
+        events[n].unixtime = _refUnix + seconds;
+        events[n].millis = ms > 999 ? 999 : ms;
+        ++n;
+    }
+    return n;
+}
@@ -0,0 +1,104 @@
+// Timestamping of external events from an interrupt handler
+// Released to the public domain! Enjoy!
+//
+// The event ISR only stores a raw tick value (micros() by default) in a
+// lock-free single producer / single consumer ring. loop() later converts a
+// batch of them to unixtime plus milliseconds against an anchor: a tick value
+// known to be the start of an RTC second. With the DS3231 1Hz square wave on
+// a second interrupt pin every falling edge renews the anchor, so the result
+// is as accurate as the RTC itself, whatever the drift of the tick source:
+//
+//   RTC_EventCapture capture;
+//   void onTip() { capture.capture(); }        // attachInterrupt(.., FALLING)
+//   void onSqw() { capture.ppsEdge(); }        // attachInterrupt(.., FALLING)
+//
+//   rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
+//   while (!capture.anchorToEdge(rtc)) ;       // in setup()
+//
+//   RtcEvent events[8];
+//   uint8_t n = capture.drain(events, 8);      // in loop()
+//
+// Without the square wave call anchor(unixtime, ticks) now and then instead.
+// Tick values wrap (every 71 minutes for micros()); events must be drained
+// within half a wrap of their capture.
+
+#ifndef _RTC_EVENT_CAPTURE_H_
+#define _RTC_EVENT_CAPTURE_H_
+
+#include "RTClibExtended.h"
+
+// Ring size, a power of two no larger than 128
+#ifndef RTC_EVENT_RING
+#define RTC_EVENT_RING               32
+#endif
+
+struct RtcEvent {
+    uint32_t unixtime;
+    uint16_t millis;
+};
+
+class RTC_EventCapture {
+public:
+    RTC_EventCapture(uint32_t ticksPerSecond = 1000000UL);
+
+    // Interrupt handlers; capture() and ppsEdge() may be in different ISRs
+    void capture()                      { capture(micros()); }
+    void capture(uint32_t ticks);
+    void ppsEdge()                      { ppsEdge(micros()); }
+    void ppsEdge(uint32_t ticks);
+
+    // Main context
+    void anchor(uint32_t unixtime, uint32_t ticks);
+    bool anchorToEdge(uint32_t unixtime, uint16_t edge);
+    template <class RTC> bool anchorToEdge(RTC& rtc);
+    bool anchored() const               { return _anchored; }
+
+    uint8_t pending() const             { return (uint8_t) (_head - _tail); }
+    uint8_t drain(RtcEvent* events, uint8_t max) { return drain(events, max, micros()); }
+    uint8_t drain(RtcEvent* events, uint8_t max, uint32_t nowTicks);
+
+    uint16_t edges() const;
+    uint16_t overflows() const;
+    uint32_t ticksPerSecond() const     { return _rate; }
+
+protected:
+    void lastEdge(uint16_t& edge, uint32_t& ticks) const;
+    void follow(uint32_t nowTicks);
+
+    // Written by the ISRs
+    volatile uint32_t _ring[RTC_EVENT_RING];
+    volatile uint8_t _head;
+    volatile uint16_t _overflows;
+    volatile uint32_t _edgeTicks;
+    volatile uint16_t _edges;
+    volatile bool _edgeSeen;
+
+    // Main context only
+    volatile uint8_t _tail;
+    uint32_t _nominal;
+    uint32_t _rate;             // measured ticks per second
+    uint32_t _refUnix;          // _refTicks is the start of this second
+    uint32_t _refTicks;
+    uint16_t _refEdge;
+    bool _anchored;
+    bool _edgeAnchored;
+};
+
+/**
+ * @brief Anchor to the last square wave edge, reading the time from rtc
+ *
+ * The edge count is taken before the clock is read, so a read that straddles
+ * an edge is detected and refused.
+ *
+ * @param rtc Any RTC class with now(), running its 1Hz output into ppsEdge()
+ * @return False if no edge has been seen or one arrived during the read;
+ * call again
+ */
+template <class RTC>
+bool RTC_EventCapture::anchorToEdge(RTC &rtc) {
+    uint16_t edge = edges();
+    DateTime now = rtc.now();
+    return anchorToEdge(now.unixtime(), edge);
+}
+
+#endif // _RTC_EVENT_CAPTURE_H_
@@ -0,0 +1,194 @@
+// Time-indexed store of recent events
+// Released to the public domain! Enjoy!
+
+#include "RTCEventStore.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_EventStore implementation
+
+/**
+ * @brief An empty store over a caller supplied array
+ *
+ * @param keys The array; it must outlive the store
+ * @param capacity Number of elements in keys
+ */
+RTC_EventStore::RTC_EventStore(uint32_t *keys, uint16_t capacity) :
+        _keys(keys),
+        _capacity(capacity) {
+    clear();
+}
+
+/**
+ * @brief Remove every event
+ */
+void RTC_EventStore::clear() {
+    _first = 0;
+    _count = 0;
+    _last = 0;
+    _segments = 0;
+    _split = false;
+}
+
+// Drop the n oldest events, and the segments left empty
+void RTC_EventStore::evict(uint16_t n) {
+    _first = (_first + n) % _capacity;
+    _count -= n;
+    uint8_t gone = 0;
+    for (uint8_t i = 0; i < _segments; ++i) {
+        _seg[i].start = _seg[i].start > n ? _seg[i].start - n : 0;
+        if (i + 1 < _segments && _seg[i + 1].start <= n)
+            ++gone;
+    }
+    if (gone) {
+        _segments -= gone;
+        memmove(_seg, _seg + gone, _segments * sizeof(Segment));
+    }
+}
+
+/**
+ * @brief Add an event, overwriting the oldest one if the store is full
+ *
+ * O(1). Events should come in time order; an earlier time than the newest
+ * event is taken as a clock step and starts a new segment. If all
+ * RTC_STORE_SEGMENTS are in use the oldest segment is dropped to make room.
+ *
+ * @param unixtime Seconds since 1/1/1970
+ * @param code Event type, stored with the time
+ */
+void RTC_EventStore::append(uint32_t unixtime, uint8_t code) {
+    if (!_capacity)
+        return;
+    if (_count == _capacity)
+        evict(1);
+
+    if (!_segments || _split || unixtime < _last || unixtime - _seg[_segments - 1].base > RTC_STORE_MAX_OFFSET) {
+        if (_segments == RTC_STORE_SEGMENTS)
+            evict(_seg[1].start);
+        // a segment whose events were all evicted is reused
+        if (_segments && _seg[_segments - 1].start == _count)
+            --_segments;
+        _seg[_segments].base = unixtime;
+        _seg[_segments].start = _count;
+        ++_segments;
+        _split = false;
+    }
+
+    _keys[(_first + _count) % _capacity] = (unixtime - _seg[_segments - 1].base) << 8 | code;
+    ++_count;
+    _last = unixtime;
+}
+
+/**
+ * @brief The event at index, oldest first
+ *
+ * @param index 0..size()-1
+ */
+RtcStoredEvent RTC_EventStore::at(uint16_t index) const {
+    uint8_t s = _segments - 1;
+    while (s && _seg[s].start > index)
+        --s;
+    uint32_t k = key(index);
+    RtcStoredEvent e;
+    e.unixtime = _seg[s].base + (k >> 8);
+    e.code = k & 0xFF;
+    return e;
+}
+
+// Index of the first event of segment at or after time t (binary search)
+uint16_t RTC_EventStore::lower(uint8_t segment, uint32_t t) const {
+    uint16_t lo = _seg[segment].start, hi = end(segment);
+    if (t <= _seg[segment].base)
+        return lo;
+    if (t - _seg[segment].base > RTC_STORE_MAX_OFFSET)
+        return hi;
+    uint32_t target = (t - _seg[segment].base) << 8;
+    while (lo < hi) {
+        uint16_t mid = lo + (hi - lo) / 2;
+        if (key(mid) < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Number of events from time from to time to, both included
+ */
+uint16_t RTC_EventStore::count(uint32_t from, uint32_t to) const {
+    if (to < from)
+        return 0;
+    uint16_t n = 0;
+    for (uint8_t s = 0; s < _segments; ++s)
+        n += (to == 0xFFFFFFFFUL ? end(s) : lower(s, to + 1)) - lower(s, from);
+    return n;
+}
+
+/**
+ * @brief Copy the events from time from to time to, both included
+ *
+ * Events are copied in storage order, which is time order unless the clock
+ * stepped back in between. O(log n) per segment plus the copy.
+ *
+ * @param events Receives up to max events
+ * @param max Size of events
+ * @return Number of events copied
+ */
+uint16_t RTC_EventStore::range(uint32_t from, uint32_t to, RtcStoredEvent *events, uint16_t max) const {
+    if (to < from)
+        return 0;
+    uint16_t n = 0;
+    for (uint8_t s = 0; s < _segments && n < max; ++s) {
+        uint16_t last = to == 0xFFFFFFFFUL ? end(s) : lower(s, to + 1);
+        for (uint16_t i = lower(s, from); i < last && n < max; ++i) {
+            uint32_t k = key(i);
+            events[n].unixtime = _seg[s].base + (k >> 8);
+            events[n].code = k & 0xFF;
+            ++n;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief The latest event at or before time t
+ *
+ * @param event Set to the event found; of equal times the most recently
+ * stored one wins
+ * @return False if there is none
+ */
+bool RTC_EventStore::before(uint32_t t, RtcStoredEvent &event) const {
+    bool found = false;
+    for (uint8_t s = 0; s < _segments; ++s) {
+        uint16_t i = t == 0xFFFFFFFFUL ? end(s) : lower(s, t + 1);
+        if (i == _seg[s].start)
+            continue;
+        RtcStoredEvent e = at(i - 1);
+        if (!found || e.unixtime >= event.unixtime) {
+            event = e;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief The earliest event at or after time t
+ *
+ * @param event Set to the event found; of equal times the first stored wins
+ * @return False if there is none
+ */
+bool RTC_EventStore::after(uint32_t t, RtcStoredEvent &event) const {
+    bool found = false;
+    for (uint8_t s = 0; s < _segments; ++s) {
+        uint16_t i = lower(s, t);
+        if (i == end(s))
+            continue;
+        RtcStoredEvent e = at(i);
+        if (!found || e.unixtime < event.unixtime) {
+            event = e;
+            found = true;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,76 @@
+// Time-indexed store of recent events
+// Released to the public domain! Enjoy!
+//
+// Keeps the most recent events in a caller supplied array of 4-byte keys:
+//
+//   key:     seconds since the segment base (24 bits) << 8 | event code
+//
+// Events are appended in time order, so each segment is sorted and range and
+// nearest-event queries are binary searches. When the clock steps back (after
+// adjust(), say) or jumps more than 194 days ahead, the next event starts a
+// new segment with its own base; queries search every segment. When the array
+// is full the oldest event is overwritten.
+//
+//   uint32_t keys[200];
+//   RTC_EventStore store(keys, 200);
+//   store.append(rtc.now(), DOOR_OPEN);
+//   RtcStoredEvent found[16];
+//   uint16_t n = store.range(t1, t2, found, 16);
+
+#ifndef _RTC_EVENT_STORE_H_
+#define _RTC_EVENT_STORE_H_
+
+#include "RTClibExtended.h"
+
+#ifndef RTC_STORE_SEGMENTS
+#define RTC_STORE_SEGMENTS           4
+#endif
+
+#define RTC_STORE_MAX_OFFSET         0xFFFFFFUL
+
+struct RtcStoredEvent {
+    uint32_t unixtime;
+    uint8_t code;
+};
+
+class RTC_EventStore {
+public:
+    RTC_EventStore(uint32_t* keys, uint16_t capacity);
+
+    void clear();
+    void split()                        { _split = true; }
+    void append(uint32_t unixtime, uint8_t code);
+    void append(const DateTime& dt, uint8_t code) { append(dt.unixtime(), code); }
+
+    uint16_t size() const               { return _count; }
+    uint16_t capacity() const           { return _capacity; }
+    uint8_t segments() const            { return _segments; }
+    RtcStoredEvent at(uint16_t index) const;
+
+    uint16_t count(uint32_t from, uint32_t to) const;
+    uint16_t range(uint32_t from, uint32_t to, RtcStoredEvent* events, uint16_t max) const;
+    bool before(uint32_t t, RtcStoredEvent& event) const;
+    bool after(uint32_t t, RtcStoredEvent& event) const;
+
+protected:
+    struct Segment {
+        uint32_t base;          // unixtime of offset 0
+        uint16_t start;         // index of the first event
+    };
+
+    uint32_t key(uint16_t index) const  { return _keys[(_first + index) % _capacity]; }
+    uint16_t end(uint8_t segment) const { return segment + 1 < _segments ? _seg[segment + 1].start : _count; }
+    uint16_t lower(uint8_t segment, uint32_t t) const;
+    void evict(uint16_t n);
+
+    uint32_t* _keys;
+    uint16_t _capacity;
+    uint16_t _first;            // array slot of the oldest event
+    uint16_t _count;
+    uint32_t _last;             // time of the newest event
+    Segment _seg[RTC_STORE_SEGMENTS];
+    uint8_t _segments;
+    bool _split;
+};
+
+#endif // _RTC_EVENT_STORE_H_
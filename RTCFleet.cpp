@@ -0,0 +1,218 @@
+// Several DS3231 clocks behind a TCA9548A style I2C multiplexer
+// Released to the public domain! Enjoy!
+
+#include <Wire.h>
+#include "RTCFleet.h"
+
+#if defined(ARDUINO_SAM_DUE)
+#define Wire Wire1
+#endif
+
+#include "RTCInstrumentation.h"
+
+#ifdef RTCLIB_INSTRUMENT
+static RTC_WireProbe<TwoWire> rtc_wire(Wire);
+#undef Wire
+#define Wire rtc_wire
+#endif
+
+static uint8_t bcd2bin(uint8_t val) { return val - 6 * (val >> 4); }
+
+static uint8_t bin2bcd(uint8_t val) { return val + 6 * (val / 10); }
+
+// Reads the 7 time registers of the selected clock from its register pointer
+static bool read_time(DateTime &dt) {
+    if (Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 7) != 7)
+        return false;
+    uint8_t ss = bcd2bin(Wire.read() & 0x7F);
+    uint8_t mm = bcd2bin(Wire.read());
+    uint8_t hh = bcd2bin(Wire.read());
+    Wire.read();
+    uint8_t d = bcd2bin(Wire.read());
+    uint8_t m = bcd2bin(Wire.read());
+    uint16_t y = bcd2bin(Wire.read()) + 2000;
+    dt = DateTime(y, m, d, hh, mm, ss);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_DS3231_Fleet implementation
+
+RTC_DS3231_Fleet::RTC_DS3231_Fleet(uint8_t muxAddress) :
+        _mux(muxAddress),
+        _count(0),
+        _selected(0),
+        _known(false),
+        _muxWrites(0) {}
+
+boolean RTC_DS3231_Fleet::begin(void) {
+    RTC_PROBE(FLEET_BEGIN);
+    Wire.begin();
+    invalidate();
+    return true;
+}
+
+/**
+ * @brief Add a clock on a multiplexer channel
+ *
+ * @param channel The multiplexer channel, 0..7
+ * @return False if the fleet is full or the channel is out of range
+ */
+bool RTC_DS3231_Fleet::add(uint8_t channel) {
+    if (_count >= RTC_FLEET_MAX || channel > 7)
+        return false;
+    _channels[_count++] = channel;
+    return true;
+}
+
+uint8_t RTC_DS3231_Fleet::allMask() const {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < _count; ++i)
+        mask |= _BV(_channels[i]);
+    return mask;
+}
+
+/**
+ * @brief Write the multiplexer control register unless it already holds mask
+ * @return False if the multiplexer did not acknowledge
+ */
+bool RTC_DS3231_Fleet::selectMask(uint8_t mask) {
+    if (_known && _selected == mask)
+        return true;
+
+    Wire.beginTransmission(_mux);
+    Wire.write(mask);
+    ++_muxWrites;
+    if (Wire.endTransmission() != 0) {
+        _known = false;
+        return false;
+    }
+    _selected = mask;
+    _known = true;
+    return true;
+}
+
+/**
+ * @brief Route the bus to one clock
+ *
+ * After this call the static RTC_DS3231 methods address that clock.
+ *
+ * @param index The clock, in the order it was added
+ * @return False if the index is out of range or the multiplexer did not answer
+ */
+bool RTC_DS3231_Fleet::select(uint8_t index) {
+    RTC_PROBE(FLEET_SELECT);
+    if (index >= _count)
+        return false;
+    return selectMask(_BV(_channels[index]));
+}
+
+/**
+ * @brief Read the time of one clock
+ *
+ * @param index The clock, in the order it was added
+ * @param dt Set to its time; left unchanged on failure
+ * @return False if the index is out of range or the multiplexer or the
+ * clock did not answer
+ */
+bool RTC_DS3231_Fleet::now(uint8_t index, DateTime &dt) {
+    RTC_PROBE(FLEET_NOW);
+    if (!select(index))
+        return false;
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write((byte) 0);
+    if (Wire.endTransmission() != 0)
+        return false;
+    return read_time(dt);
+}
+
+/**
+ * @brief Set every clock at the same instant
+ *
+ * All channels are opened at once so one write reaches every chip and they
+ * all restart their seconds countdown together. OSF is left for each clock's
+ * own adjust() or lostPower() handling.
+ *
+ * @return False if the multiplexer or no clock acknowledged
+ */
+bool RTC_DS3231_Fleet::adjustAll(const DateTime &dt) {
+    RTC_PROBE(FLEET_ADJUSTALL);
+    if (!selectMask(allMask()))
+        return false;
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write((byte) 0); // start at location 0
+    Wire.write(bin2bcd(dt.second()));
+    Wire.write(bin2bcd(dt.minute()));
+    Wire.write(bin2bcd(dt.hour()));
+    Wire.write(bin2bcd(0));
+    Wire.write(bin2bcd(dt.day()));
+    Wire.write(bin2bcd(dt.month()));
+    Wire.write(bin2bcd(dt.year() - 2000));
+    return Wire.endTransmission() == 0;
+}
+
+/**
+ * @brief Read every clock and compare them
+ *
+ * The register pointer of all chips is reset with a single write while every
+ * channel is open; after that each clock costs one channel switch and one
+ * 7 byte read, keeping the sweep, and so the skew between readings, short.
+ *
+ * @param readings Array of size() entries, one per clock
+ * @param report Set to the median time and the number of valid readings and outliers
+ * @param toleranceSec A clock more than this many seconds from the median is an outlier
+ * @return The number of clocks that answered and agree with the median
+ */
+uint8_t RTC_DS3231_Fleet::sweep(RtcFleetReading *readings, RtcFleetReport &report, uint8_t toleranceSec) {
+    RTC_PROBE(FLEET_SWEEP);
+    report.valid = 0;
+    report.outliers = 0;
+    report.median = DateTime();
+
+    if (selectMask(allMask())) {
+        Wire.beginTransmission(DS3231_ADDRESS);
+        Wire.write((byte) 0);
+        Wire.endTransmission();
+    }
+
+    uint32_t sorted[RTC_FLEET_MAX];
+    for (uint8_t i = 0; i < _count; ++i) {
+        RtcFleetReading &r = readings[i];
+        r.ok = false;
+        r.outlier = false;
+        r.delta = 0;
+        if (!select(i))
+            continue;
+
+        r.micros = micros();
+        if (!read_time(r.time))
+            continue;
+        r.ok = true;
+
+        // insertion sort, the fleet is small
+        uint32_t t = r.time.unixtime();
+        uint8_t j = report.valid++;
+        for (; j > 0 && sorted[j - 1] > t; --j)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = t;
+    }
+
+    if (report.valid == 0)
+        return 0;
+
+    uint32_t median = sorted[(report.valid - 1) / 2];
+    report.median = DateTime(median);
+    for (uint8_t i = 0; i < _count; ++i) {
+        RtcFleetReading &r = readings[i];
+        if (!r.ok)
+            continue;
+        r.delta = (int32_t) (r.time.unixtime() - median);
+        if (r.delta > toleranceSec || r.delta < -(int32_t) toleranceSec) {
+            r.outlier = true;
+            ++report.outliers;
+        }
+    }
+    return report.valid - report.outliers;
+}
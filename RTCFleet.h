@@ -0,0 +1,62 @@
+// Several DS3231 clocks behind a TCA9548A style I2C multiplexer
+// Released to the public domain! Enjoy!
+
+#ifndef _RTC_FLEET_H_
+#define _RTC_FLEET_H_
+
+#include "RTClibExtended.h"
+
+#define TCA9548A_ADDRESS             0x70
+
+#ifndef RTC_FLEET_MAX
+#define RTC_FLEET_MAX                8
+#endif
+
+struct RtcFleetReading {
+    DateTime time;
+    uint32_t micros;        // micros() just before the clock was read
+    int32_t delta;          // seconds from the fleet median
+    bool ok;                // false if the clock did not answer
+    bool outlier;           // |delta| above the sweep tolerance
+};
+
+struct RtcFleetReport {
+    DateTime median;
+    uint8_t valid;          // clocks that answered
+    uint8_t outliers;
+};
+
+// Addresses up to RTC_FLEET_MAX DS3231 chips, all at DS3231_ADDRESS, each on
+// its own multiplexer channel. After select() any RTC_DS3231 method talks to
+// that clock. The selected channel mask is cached so repeated accesses to the
+// same clock cost no switch writes.
+class RTC_DS3231_Fleet {
+public:
+    RTC_DS3231_Fleet(uint8_t muxAddress = TCA9548A_ADDRESS);
+
+    boolean begin(void);
+    bool add(uint8_t channel);
+    uint8_t size() const                { return _count; }
+    uint8_t channel(uint8_t index) const { return _channels[index]; }
+
+    bool select(uint8_t index);
+    void invalidate()                   { _known = false; }
+    uint16_t muxWrites() const          { return _muxWrites; }
+
+    bool now(uint8_t index, DateTime& dt);
+    bool adjustAll(const DateTime& dt);
+    uint8_t sweep(RtcFleetReading* readings, RtcFleetReport& report, uint8_t toleranceSec = 1);
+
+protected:
+    bool selectMask(uint8_t mask);
+    uint8_t allMask() const;
+
+    uint8_t _mux;
+    uint8_t _channels[RTC_FLEET_MAX];
+    uint8_t _count;
+    uint8_t _selected;
+    bool _known;
+    uint16_t _muxWrites;
+};
+
+#endif // _RTC_FLEET_H_
@@ -0,0 +1,84 @@
+// Bus instrumentation for the RTC library
+// Released to the public domain! Enjoy!
+
+#include "RTCInstrumentation.h"
+
+#ifdef RTCLIB_INSTRUMENT
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#elif defined(ESP8266)
+#include <pgmspace.h>
+#endif
+
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(addr) (*(const void * const *)(addr))
+#endif
+
+RtcProbeOp RTC_Instrumentation::current = RTC_OP_OTHER;
+RtcProbeStats RTC_Instrumentation::stats[RTC_OP_COUNT];
+
+// Method names live in flash, one string per op
+#define RTC_PROBE_NAME(name) static const char rtc_probe_name_##name[] PROGMEM = #name;
+RTC_PROBE_OPS(RTC_PROBE_NAME)
+#undef RTC_PROBE_NAME
+
+#define RTC_PROBE_NAME(name) rtc_probe_name_##name,
+static const char *const rtc_probe_names[] PROGMEM = { RTC_PROBE_OPS(RTC_PROBE_NAME) };
+#undef RTC_PROBE_NAME
+
+RTC_ProbeScope::~RTC_ProbeScope() {
+    uint32_t us = micros() - _start;
+    RtcProbeStats &s = RTC_Instrumentation::stats[RTC_Instrumentation::current];
+    if (s.calls == 0 || us < s.usMin)
+        s.usMin = us;
+    if (us > s.usMax)
+        s.usMax = us;
+    s.usSum += us;
+    ++s.calls;
+    RTC_Instrumentation::current = _outer;
+}
+
+/**
+ * @brief Zero all counters
+ */
+void RTC_Instrumentation::reset() {
+    memset(stats, 0, sizeof(stats));
+}
+
+/**
+ * @brief The name of an instrumented method, e.g. "DS3231_NOW"
+ */
+const __FlashStringHelper *RTC_Instrumentation::name(RtcProbeOp op) {
+    return (const __FlashStringHelper *) pgm_read_ptr(rtc_probe_names + op);
+}
+
+/**
+ * @brief Print one line per method that was used
+ *
+ * Columns: name, calls, transactions, bytes, min/max/sum microseconds.
+ *
+ * @param out Where to print, e.g. Serial
+ */
+void RTC_Instrumentation::dump(Print &out) {
+    for (uint8_t op = 0; op < RTC_OP_COUNT; ++op) {
+        const RtcProbeStats &s = stats[op];
+        if (s.calls == 0 && s.transactions == 0)
+            continue;
+        out.print(name((RtcProbeOp) op));
+        out.print(' ');
+        out.print((unsigned long) s.calls);
+        out.print(' ');
+        out.print((unsigned long) s.transactions);
+        out.print(' ');
+        out.print((unsigned long) s.bytes);
+        out.print(' ');
+        out.print((unsigned long) s.usMin);
+        out.print(' ');
+        out.print((unsigned long) s.usMax);
+        out.print(' ');
+        out.println((unsigned long) s.usSum);
+    }
+}
+
+#endif // RTCLIB_INSTRUMENT
@@ -0,0 +1,118 @@
+// Bus instrumentation for the RTC library
+// Released to the public domain! Enjoy!
+//
+// Counts the I2C transactions, bytes and time spent in every RTC_* method.
+// Uncomment the define below (or build with -DRTCLIB_INSTRUMENT) to enable
+// it; when disabled everything here compiles to nothing. Then call
+// RTC_Instrumentation::dump(Serial) to print the per-method statistics.
+
+#ifndef _RTC_INSTRUMENTATION_H_
+#define _RTC_INSTRUMENTATION_H_
+
+//#define RTCLIB_INSTRUMENT
+
+#ifdef RTCLIB_INSTRUMENT
+
+#include <Arduino.h>
+
+// Every instrumented call site. OTHER collects bus traffic made outside of
+// an instrumented method.
+#define RTC_PROBE_OPS(X) \
+    X(OTHER) \
+    X(DS1307_BEGIN) X(DS1307_ISRUNNING) X(DS1307_ADJUST) X(DS1307_NOW) \
+    X(DS1307_READSQWPINMODE) X(DS1307_WRITESQWPINMODE) X(DS1307_READNVRAM) X(DS1307_WRITENVRAM) \
+    X(PCF8523_BEGIN) X(PCF8523_INITIALIZED) X(PCF8523_ADJUST) X(PCF8523_NOW) \
+    X(PCF8523_READSQWPINMODE) X(PCF8523_WRITESQWPINMODE) X(PCF8523_ENABLECOUNTDOWNTIMER) \
+    X(PCF8523_DISABLECOUNTDOWNTIMER) X(PCF8523_COUNTDOWNFIRED) X(PCF8523_CLEARCOUNTDOWNFLAG) \
+    X(PCF8523_WRITEOFFSET) X(PCF8523_READOFFSET) \
+    X(DS3231_BEGIN) X(DS3231_LOSTPOWER) X(DS3231_ADJUST) X(DS3231_ADJUSTALIGNED) X(DS3231_NOW) \
+    X(DS3231_READSQWPINMODE) X(DS3231_WRITESQWPINMODE) X(DS3231_GETTEMP) \
+    X(DS3231_GETEN32KHZ) X(DS3231_SETEN32KHZ) X(DS3231_GETBBSQW) X(DS3231_SETBBSQW) \
+    X(DS3231_ALARMINTERRUPT) X(DS3231_SETALARM) X(DS3231_ARMALARM) X(DS3231_CLEARALARM) \
+    X(DS3231_ISARMED) X(DS3231_WRITE) X(DS3231_READ) X(DS3231_FORCECONVERSION) \
+    X(DS3231_GETAGINGOFFSET) X(DS3231_SETAGINGOFFSET) X(DS3231_REFRESH) X(DS3231_SAMPLETEMP) \
+    X(FLEET_BEGIN) X(FLEET_SELECT) X(FLEET_NOW) X(FLEET_ADJUSTALL) X(FLEET_SWEEP) \
+    X(AUTO_PROBE)
+
+#define RTC_PROBE_ENUM(name) RTC_OP_##name,
+enum RtcProbeOp { RTC_PROBE_OPS(RTC_PROBE_ENUM) RTC_OP_COUNT };
+#undef RTC_PROBE_ENUM
+
+struct RtcProbeStats {
+    uint32_t calls;
+    uint32_t transactions;  // beginTransmission() and requestFrom() calls
+    uint32_t bytes;         // bytes written plus bytes requested
+    uint32_t usMin;
+    uint32_t usMax;
+    uint32_t usSum;
+};
+
+class RTC_Instrumentation {
+public:
+    static void reset();
+    static const RtcProbeStats& get(RtcProbeOp op) { return stats[op]; }
+    static const __FlashStringHelper* name(RtcProbeOp op);
+    static void dump(Print& out);
+
+    // Used by RTC_WireProbe and RTC_ProbeScope
+    static void countTransaction(uint8_t bytes) { ++stats[current].transactions; stats[current].bytes += bytes; }
+    static void countByte()                     { ++stats[current].bytes; }
+
+    static RtcProbeOp current;
+    static RtcProbeStats stats[RTC_OP_COUNT];
+};
+
+// Attributes the bus traffic and time of one method call to its op. Scopes
+// nest; time is inclusive, traffic goes to the innermost scope.
+class RTC_ProbeScope {
+public:
+    RTC_ProbeScope(RtcProbeOp op) : _outer(RTC_Instrumentation::current), _start(micros()) {
+        RTC_Instrumentation::current = op;
+    }
+    ~RTC_ProbeScope();
+
+private:
+    RtcProbeOp _outer;
+    uint32_t _start;
+};
+
+// Stands in for the Wire object inside the library and counts what passes through
+template <class W>
+class RTC_WireProbe {
+public:
+    RTC_WireProbe(W& wire) : _wire(wire) {}
+    void begin() { _wire.begin(); }
+    void beginTransmission(uint8_t addr) {
+        RTC_Instrumentation::countTransaction(1);
+        _wire.beginTransmission(addr);
+    }
+    void beginTransmission(int addr) { beginTransmission((uint8_t) addr); }
+    size_t write(uint8_t val) {
+        RTC_Instrumentation::countByte();
+        return _wire.write(val);
+    }
+    size_t send(uint8_t val) { return write(val); }
+    uint8_t endTransmission() { return _wire.endTransmission(); }
+    uint8_t endTransmission(uint8_t sendStop) { return _wire.endTransmission(sendStop); }
+    uint8_t requestFrom(uint8_t addr, uint8_t quantity) {
+        RTC_Instrumentation::countTransaction(1 + quantity);
+        return _wire.requestFrom(addr, quantity);
+    }
+    uint8_t requestFrom(int addr, int quantity) { return requestFrom((uint8_t) addr, (uint8_t) quantity); }
+    int available() { return _wire.available(); }
+    int read() { return _wire.read(); }
+    int receive() { return read(); }
+
+private:
+    W& _wire;
+};
+
+#define RTC_PROBE(op) RTC_ProbeScope _rtc_probe(RTC_OP_##op)
+
+#else
+
+#define RTC_PROBE(op)
+
+#endif // RTCLIB_INSTRUMENT
+
+#endif // _RTC_INSTRUMENTATION_H_
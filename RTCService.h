@@ -0,0 +1,301 @@
+// Multi-threaded access to an RTC through a single bus-owner thread
+// Released to the public domain! Enjoy!
+//
+// For ESP32 and Linux class systems with <thread> and <atomic>. One worker
+// thread owns the I2C bus; client threads queue requests on a lock-free
+// multi-producer queue and sleep until the answer is in. Identical requests that are
+// pending together are served by one bus read, so any number of threads
+// calling now() cost at most one transaction per batch.
+//
+//   RTC_DS3231 rtc;
+//   RTC_DS3231_Service service(rtc);
+//   service.start();
+//   DateTime t;
+//   service.now(t);            // from any thread
+//
+// The template parameter only needs now() and getTemp(), so the service can
+// be run against a simulated clock on a host. On AVR this header is empty.
+
+#ifndef _RTC_SERVICE_H_
+#define _RTC_SERVICE_H_
+
+#include "RTClibExtended.h"
+
+#if defined(__has_include)
+#if __has_include(<thread>) && __has_include(<atomic>)
+#define RTCLIB_HAS_THREADS
+#endif
+#endif
+
+#ifdef RTCLIB_HAS_THREADS
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum RtcServiceOp { RTC_SERVICE_NOW = 0, RTC_SERVICE_TEMP, RTC_SERVICE_OPS };
+
+// Latency histogram: bucket i counts requests answered in [2^i, 2^(i+1)) us
+#define RTC_SERVICE_BUCKETS          24
+
+// One queued request. It lives on the client's stack; the client does not
+// return until the worker has marked it done and no longer references it.
+struct RtcServiceRequest {
+    std::atomic<RtcServiceRequest*> next;
+    RtcServiceRequest* batchNext;
+    RtcServiceOp op;
+    std::atomic<bool> done;
+    std::chrono::steady_clock::time_point submitted;
+    uint32_t unixtime;
+    float temp;
+};
+
+template <class RTC>
+class RTC_Service {
+public:
+    RTC_Service(RTC& rtc) : _rtc(rtc), _head(&_stub), _tail(&_stub), _running(false),
+                            _clients(0), _pending(0), _requests(0), _busReads(0) {
+        _stub.next.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < RTC_SERVICE_BUCKETS; ++i)
+            _histogram[i].store(0, std::memory_order_relaxed);
+    }
+    ~RTC_Service() { stop(); }
+
+    bool start();
+    void stop();
+
+    // Blocking calls, safe from any thread; false if the service is stopped
+    bool now(DateTime& dt);
+    bool temperature(float& temp);
+
+    uint32_t requests() const   { return _requests.load(std::memory_order_relaxed); }
+    uint32_t busReads() const   { return _busReads.load(std::memory_order_relaxed); }
+    uint32_t latencyPercentileUs(float p) const;
+
+protected:
+    bool call(RtcServiceRequest& r);
+    void push(RtcServiceRequest* r);
+    RtcServiceRequest* pop();
+    void run();
+    void serve(RtcServiceRequest* batch);
+
+    RTC& _rtc;
+    RtcServiceRequest _stub;
+    std::atomic<RtcServiceRequest*> _head;   // producers push here
+    RtcServiceRequest* _tail;                // only the worker touches this
+    std::atomic<bool> _running;
+    std::atomic<int> _clients;
+    std::atomic<int> _pending;
+    std::atomic<uint32_t> _requests;
+    std::atomic<uint32_t> _busReads;
+    std::atomic<uint32_t> _histogram[RTC_SERVICE_BUCKETS];
+    std::thread _worker;
+    std::mutex _sleepLock;
+    std::condition_variable _wake;
+    std::mutex _doneLock;
+    std::condition_variable _done;          // some requests were answered
+};
+
+typedef RTC_Service<RTC_DS3231> RTC_DS3231_Service;
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_Service implementation
+
+template <class RTC>
+bool RTC_Service<RTC>::start() {
+    if (_running.exchange(true))
+        return false;
+    _worker = std::thread(&RTC_Service::run, this);
+    return true;
+}
+
+// Refuse new requests, answer the queued ones and join the worker
+template <class RTC>
+void RTC_Service<RTC>::stop() {
+    if (!_running.exchange(false, std::memory_order_seq_cst))
+        return;
+    _wake.notify_one();
+    _worker.join();
+}
+
+template <class RTC>
+bool RTC_Service<RTC>::now(DateTime &dt) {
+    RtcServiceRequest r;
+    r.op = RTC_SERVICE_NOW;
+    if (!call(r))
+        return false;
+    dt = DateTime(r.unixtime);
+    return true;
+}
+
+template <class RTC>
+bool RTC_Service<RTC>::temperature(float &temp) {
+    RtcServiceRequest r;
+    r.op = RTC_SERVICE_TEMP;
+    if (!call(r))
+        return false;
+    temp = r.temp;
+    return true;
+}
+
+template <class RTC>
+bool RTC_Service<RTC>::call(RtcServiceRequest &r) {
+    // Registering as a client first means stop() waits for us. This is a
+    // store then a load on each side (here _clients then _running, in stop()
+    // and run() _running then _clients), which only seq_cst keeps in order:
+    // with acquire/release both sides could read the old value, and the
+    // worker could exit with our request still queued.
+    _clients.fetch_add(1, std::memory_order_seq_cst);
+    if (!_running.load(std::memory_order_seq_cst)) {
+        _clients.fetch_sub(1, std::memory_order_seq_cst);
+        return false;
+    }
+
+    r.done.store(false, std::memory_order_relaxed);
+    r.submitted = std::chrono::steady_clock::now();
+    push(&r);
+    if (_pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+        _wake.notify_one();
+
+    {
+        std::unique_lock<std::mutex> lock(_doneLock);
+        _done.wait(lock, [&r] { return r.done.load(std::memory_order_acquire); });
+    }
+    _clients.fetch_sub(1, std::memory_order_seq_cst);
+    return true;
+}
+
+// Vyukov's intrusive MPSC queue: one exchange per push, wait-free for producers
+template <class RTC>
+void RTC_Service<RTC>::push(RtcServiceRequest *r) {
+    r->next.store(0, std::memory_order_relaxed);
+    RtcServiceRequest *prev = _head.exchange(r, std::memory_order_acq_rel);
+    prev->next.store(r, std::memory_order_release);
+}
+
+// Returns 0 if the queue is empty or a push is half done
+template <class RTC>
+RtcServiceRequest *RTC_Service<RTC>::pop() {
+    RtcServiceRequest *tail = _tail;
+    RtcServiceRequest *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &_stub) {
+        if (!next)
+            return 0;
+        _tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    if (tail != _head.load(std::memory_order_acquire))
+        return 0;
+    push(&_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        _tail = next;
+        return tail;
+    }
+    return 0;
+}
+
+template <class RTC>
+void RTC_Service<RTC>::run() {
+    while (_running.load(std::memory_order_seq_cst) || _clients.load(std::memory_order_seq_cst) > 0) {
+        RtcServiceRequest *batch = 0;
+        int n = 0;
+        for (RtcServiceRequest *r = pop(); r; r = pop()) {
+            r->batchNext = batch;
+            batch = r;
+            ++n;
+        }
+        if (batch) {
+            _pending.fetch_sub(n, std::memory_order_acq_rel);
+            serve(batch);
+            continue;
+        }
+
+        // The timeout bounds the delay of a wakeup lost between a client's
+        // push and notify_one()
+        std::unique_lock<std::mutex> lock(_sleepLock);
+        _wake.wait_for(lock, std::chrono::milliseconds(1), [this] {
+            return _pending.load(std::memory_order_acquire) > 0 || !_running.load(std::memory_order_acquire);
+        });
+    }
+}
+
+// One bus read per kind of request in the batch, shared by all of them
+template <class RTC>
+void RTC_Service<RTC>::serve(RtcServiceRequest *batch) {
+    bool wanted[RTC_SERVICE_OPS] = {false, false};
+    for (RtcServiceRequest *r = batch; r; r = r->batchNext)
+        wanted[r->op] = true;
+
+    uint32_t unixtime = 0;
+    float temp = 0;
+    if (wanted[RTC_SERVICE_NOW]) {
+        unixtime = _rtc.now().unixtime();
+        _busReads.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (wanted[RTC_SERVICE_TEMP]) {
+        temp = _rtc.getTemp();
+        _busReads.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+    // Marking the requests done under the lock means a client cannot check
+    // its flag, miss it and then sleep through the notify below
+    std::unique_lock<std::mutex> lock(_doneLock);
+    RtcServiceRequest *r = batch;
+    while (r) {
+        RtcServiceRequest *following = r->batchNext;
+        uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(done - r->submitted).count();
+        int bucket = 0;
+        while (us > 1 && bucket < RTC_SERVICE_BUCKETS - 1) {
+            us >>= 1;
+            ++bucket;
+        }
+        _histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        _requests.fetch_add(1, std::memory_order_relaxed);
+
+        r->unixtime = unixtime;
+        r->temp = temp;
+        // After this store the client may return and r is gone
+        r->done.store(true, std::memory_order_release);
+        r = following;
+    }
+    lock.unlock();
+    _done.notify_all();
+}
+
+/**
+ * @brief Latency percentile from the histogram
+ *
+ * @param p Percentile, 0..100
+ * @return Upper bound of the histogram bucket holding the percentile, in
+ * microseconds (within a factor of two), or 0 if nothing was served
+ */
+template <class RTC>
+uint32_t RTC_Service<RTC>::latencyPercentileUs(float p) const {
+    uint32_t total = 0;
+    for (int i = 0; i < RTC_SERVICE_BUCKETS; ++i)
+        total += _histogram[i].load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    uint32_t target = (uint32_t) (total * p / 100.0f);
+    uint32_t seen = 0;
+    for (int i = 0; i < RTC_SERVICE_BUCKETS; ++i) {
+        seen += _histogram[i].load(std::memory_order_relaxed);
+        if (seen > target || seen == total)
+            return 2UL << i;
+    }
+    return 2UL << (RTC_SERVICE_BUCKETS - 1);
+}
+
+#endif // RTCLIB_HAS_THREADS
+
+#endif // _RTC_SERVICE_H_
@@ -0,0 +1,99 @@
+// Software alarms with the DS3231 match modes for any RTC class
+// Released to the public domain! Enjoy!
+
+#include "RTCSoftAlarm.h"
+
+// Same convention as date2days(): valid for 2000..2099
+static uint8_t days_in_month(uint16_t y, uint8_t m) {
+    if (m == 2)
+        return y % 4 == 0 ? 29 : 28;
+    return m == 4 || m == 6 || m == 9 || m == 11 ? 30 : 31;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_SoftAlarm implementation
+
+/**
+ * @brief Set the match mode and fields, as for RTC_DS3231::setAlarm()
+ *
+ * @param alarmType One of Ds3231_ALARM_TYPES_t; ALM2_* types ignore seconds
+ * @param daydate Date 1..31, or for ALMx_MATCH_DAY the weekday 1..7 with
+ * 1 as Sunday
+ */
+void RTC_SoftAlarm::set(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate) {
+    _type = alarmType;
+    _seconds = alarmType & 0x80 ? 0 : seconds;
+    _minutes = minutes;
+    _hours = hours;
+    _daydate = daydate;
+}
+
+/**
+ * @brief The first matching time after a given time
+ *
+ * Every mode but ALMx_MATCH_DATE repeats with a fixed period (a minute, an
+ * hour, a day or a week), so the match is one modulo away. Date matches
+ * skip the months too short for the date, as the DS3231 does.
+ *
+ * @param after Seconds since 1/1/1970
+ * @param match Set to the first matching time strictly after after
+ * @return False if the fields can never match
+ */
+bool RTC_SoftAlarm::next(uint32_t after, uint32_t &match) const {
+    if (_seconds > 59 || _minutes > 59 || _hours > 23)
+        return false;
+
+    uint32_t t = after + 1;
+    uint32_t period, offset;
+    if ((_type & 0x0F) == 0x0F) {           // every second
+        match = t;
+        return true;
+    } else if (_type & 0x02) {              // minutes don't care
+        period = 60;
+        offset = _seconds;
+    } else if (_type & 0x04) {              // hours don't care
+        period = 3600;
+        offset = _minutes * 60 + _seconds;
+    } else if (_type & 0x08) {              // day/date don't care
+        period = 86400L;
+        offset = _hours * 3600L + _minutes * 60 + _seconds;
+    } else if (_type & 0x10) {              // day of the week
+        if (_daydate < 1 || _daydate > 7)
+            return false;
+        // 1/1/1970 was a Thursday, weekday 5 in the 1..7 numbering
+        period = 7 * 86400L;
+        offset = (_daydate + 2) % 7 * 86400L + _hours * 3600L + _minutes * 60 + _seconds;
+    } else {                                // date of the month
+        if (_daydate < 1 || _daydate > 31)
+            return false;
+        DateTime now(t);
+        uint16_t y = now.year();
+        uint8_t m = now.month();
+        for (uint8_t i = 0; i < 4; ++i) {
+            if (_daydate <= days_in_month(y, m)) {
+                match = DateTime(y, m, _daydate, _hours, _minutes, _seconds).unixtime();
+                if (match >= t)
+                    return true;
+            }
+            if (++m > 12) {
+                m = 1;
+                ++y;
+            }
+        }
+        return false;
+    }
+
+    match = t + (offset + period - t % period) % period;
+    return true;
+}
+
+/**
+ * @brief DateTime version of next()
+ */
+bool RTC_SoftAlarm::next(const DateTime &after, DateTime &match) const {
+    uint32_t t;
+    if (!next(after.unixtime(), t))
+        return false;
+    match = DateTime(t);
+    return true;
+}
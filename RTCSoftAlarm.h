@@ -0,0 +1,214 @@
+// Software alarms with the DS3231 match modes for any RTC class
+// Released to the public domain! Enjoy!
+//
+// RTC_SoftAlarm computes the next time matching a Ds3231_ALARM_TYPES_t
+// setting directly, with no second-by-second search. RTC_AlarmClock wraps any
+// clock with a now() method (RTC_DS1307, RTC_PCF8523, RTC_Millis, ...) and
+// offers the two alarms of the DS3231 with the same calls, so firmware can
+// use alarms on every chip:
+//
+//   RTC_PCF8523 rtc;
+//   RTC_AlarmClock<RTC_PCF8523> alarms(rtc);
+//   alarms.setAlarm(ALM1_MATCH_HOURS, 0, 30, 6, 0);   // 06:30:00 daily, armed
+//   ...
+//   if (alarms.poll() & 0x01) { alarms.clearAlarm(1); ... }     // in loop()
+//
+// poll() only reads the clock once millis() says the earliest deadline has
+// come, so it is cheap to call often; msUntilNext() tells how long to sleep.
+// Alarms fire within a second of their time (plus millis() drift, re-read at
+// least every RTC_ALARM_RECHECK seconds). For ALMx_MATCH_DAY, daydate 1 is
+// Sunday (DateTime::dayOfTheWeek() + 1).
+
+#ifndef _RTC_SOFT_ALARM_H_
+#define _RTC_SOFT_ALARM_H_
+
+#include "RTClibExtended.h"
+
+#define RTC_ALARM_RECHECK            3600
+
+class RTC_SoftAlarm {
+public:
+    RTC_SoftAlarm() : _type(ALM1_EVERY_SECOND), _seconds(0), _minutes(0), _hours(0), _daydate(0) {}
+
+    void set(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate);
+    Ds3231_ALARM_TYPES_t type() const   { return _type; }
+
+    bool next(uint32_t after, uint32_t& match) const;
+    bool next(const DateTime& after, DateTime& match) const;
+
+protected:
+    Ds3231_ALARM_TYPES_t _type;
+    byte _seconds;
+    byte _minutes;
+    byte _hours;
+    byte _daydate;
+};
+
+template <class RTC>
+class RTC_AlarmClock {
+public:
+    RTC_AlarmClock(RTC& rtc) : _rtc(rtc), _armed(0), _fired(0), _readAt(0), _readTime(0), _reads(0) {}
+
+    // Same meaning as the RTC_DS3231 methods; alarm 1 or 2 is chosen by the type
+    void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate);
+    void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte minutes, byte hours, byte daydate) {
+        setAlarm(alarmType, 0, minutes, hours, daydate);
+    }
+    void armAlarm(byte alarmNumber, bool armed);
+    // The DS3231 keeps no separate enable: AxIE is the bit armAlarm() sets
+    void alarmInterrupt(byte alarmNumber, bool enabled) { armAlarm(alarmNumber, enabled); }
+    bool isArmed(byte alarmNumber) const    { return _armed & bit(alarmNumber); }
+    bool alarmFired(byte alarmNumber) const { return _fired & bit(alarmNumber); }
+    void clearAlarm(byte alarmNumber)       { _fired &= ~bit(alarmNumber); }
+
+    uint8_t poll();
+    void resync();
+    uint32_t msUntilNext() const;
+    uint32_t deadline(byte alarmNumber) const { return _deadline[index(alarmNumber)]; }
+    uint16_t clockReads() const             { return _reads; }
+
+protected:
+    static uint8_t index(byte alarmNumber)  { return alarmNumber == 2 ? 1 : 0; }
+    static uint8_t bit(byte alarmNumber)    { return 1 << index(alarmNumber); }
+    void read();
+    void schedule(uint8_t i);
+    uint32_t waitMs() const;
+
+    RTC& _rtc;
+    RTC_SoftAlarm _alarm[2];
+    uint32_t _deadline[2];
+    uint8_t _armed;             // bit 0 alarm 1, bit 1 alarm 2
+    uint8_t _fired;
+    uint32_t _readAt;           // millis() at the last clock read
+    uint32_t _readTime;         // and the time read
+    uint16_t _reads;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_AlarmClock implementation
+
+template <class RTC>
+void RTC_AlarmClock<RTC>::read() {
+    _readTime = _rtc.now().unixtime();
+    _readAt = millis();
+    ++_reads;
+}
+
+// An alarm that can never match (date 31 with seconds 75, say) is disarmed
+template <class RTC>
+void RTC_AlarmClock<RTC>::schedule(uint8_t i) {
+    if (!_alarm[i].next(_readTime, _deadline[i]))
+        _armed &= ~(1 << i);
+}
+
+/**
+ * @brief Set an alarm, arm it and clear its flag, as RTC_DS3231::setAlarm() does
+ *
+ * Reads the clock once.
+ *
+ * @param alarmType One of Ds3231_ALARM_TYPES_t; ALM2_* types set alarm 2,
+ * whose seconds are always 0
+ */
+template <class RTC>
+void RTC_AlarmClock<RTC>::setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate) {
+    uint8_t i = alarmType & 0x80 ? 1 : 0;
+    _alarm[i].set(alarmType, seconds, minutes, hours, daydate);
+    _armed |= 1 << i;
+    _fired &= ~(1 << i);
+    read();
+    schedule(i);
+}
+
+/**
+ * @brief Arm or disarm an alarm; arming reads the clock once
+ */
+template <class RTC>
+void RTC_AlarmClock<RTC>::armAlarm(byte alarmNumber, bool armed) {
+    uint8_t i = index(alarmNumber);
+    if (!armed) {
+        _armed &= ~(1 << i);
+        return;
+    }
+    _armed |= 1 << i;
+    read();
+    schedule(i);
+}
+
+/**
+ * @brief Recompute the deadlines, e.g. after the clock was adjusted
+ */
+template <class RTC>
+void RTC_AlarmClock<RTC>::resync() {
+    if (!_armed)
+        return;
+    read();
+    for (uint8_t i = 0; i < 2; ++i)
+        if (_armed & (1 << i))
+            schedule(i);
+}
+
+// Milliseconds from the last read until the earliest deadline is due; 0 if
+// one had already passed at that read (arming one alarm reads the clock
+// without checking the other)
+template <class RTC>
+uint32_t RTC_AlarmClock<RTC>::waitMs() const {
+    uint32_t seconds = RTC_ALARM_RECHECK;
+    for (uint8_t i = 0; i < 2; ++i) {
+        if (!(_armed & (1 << i)))
+            continue;
+        int32_t left = (int32_t) (_deadline[i] - _readTime);
+        if (left <= 0)
+            return 0;
+        if ((uint32_t) left < seconds)
+            seconds = left;
+    }
+    return seconds * 1000;
+}
+
+/**
+ * @brief Check the alarms; call often from loop()
+ *
+ * The clock is only read when an armed alarm is due by millis(), or
+ * RTC_ALARM_RECHECK seconds after the last read. An alarm whose time passed
+ * while poll() was not called fires once, late, like a missed DS3231 flag
+ * that was never cleared.
+ *
+ * @return Bit 0 set if alarm 1 fired in this call, bit 1 for alarm 2. The
+ * alarmFired() flags stay set until clearAlarm().
+ */
+template <class RTC>
+uint8_t RTC_AlarmClock<RTC>::poll() {
+    if (!_armed || millis() - _readAt < waitMs())
+        return 0;
+
+    uint32_t last = _readTime;
+    read();
+    if (_readTime < last) {
+        // the clock went back; matches in the repeated stretch are due again
+        resync();
+        return 0;
+    }
+
+    uint8_t fired = 0;
+    for (uint8_t i = 0; i < 2; ++i) {
+        if ((_armed & (1 << i)) && (int32_t) (_readTime - _deadline[i]) >= 0) {
+            fired |= 1 << i;
+            schedule(i);
+        }
+    }
+    _fired |= fired;
+    return fired;
+}
+
+/**
+ * @brief Milliseconds until poll() will next read the clock, for sleeping
+ */
+template <class RTC>
+uint32_t RTC_AlarmClock<RTC>::msUntilNext() const {
+    if (!_armed)
+        return 0xFFFFFFFFUL;
+    uint32_t elapsed = millis() - _readAt, wait = waitMs();
+    return elapsed < wait ? wait - elapsed : 0;
+}
+
+#endif // _RTC_SOFT_ALARM_H_
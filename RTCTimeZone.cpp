@@ -0,0 +1,106 @@
+// Time zone and daylight saving time conversion
+// Released to the public domain! Enjoy!
+
+#include "RTCTimeZone.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#elif defined(ESP8266)
+#include <pgmspace.h>
+#endif
+
+#ifndef pgm_read_dword
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_TimeZone implementation
+
+/**
+ * @brief A zone; normally made with RTC_TIMEZONE or RTC_FIXED_TIMEZONE
+ *
+ * @param transitions Sorted table in flash, see rtcTzFirst()
+ * @param count Number of table entries
+ * @param stdOffset Standard time offset in minutes east of UTC
+ * @param dstOffset Daylight time offset in minutes east of UTC
+ */
+RTC_TimeZone::RTC_TimeZone(const uint32_t *transitions, uint8_t count, int16_t stdOffset, int16_t dstOffset) :
+        _transitions(transitions),
+        _count(count),
+        _stdOffset(stdOffset),
+        _dstOffset(dstOffset) {}
+
+uint32_t RTC_TimeZone::entry(uint8_t i) const {
+    return pgm_read_dword(_transitions + i);
+}
+
+// Number of transitions at or before t (seconds since 1/1/2000)
+uint8_t RTC_TimeZone::upperBound(uint32_t t) const {
+    uint8_t lo = 0, hi = _count;
+    while (lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        if ((entry(mid) & ~1UL) <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Is daylight saving time in effect?
+ *
+ * @param utc Seconds since 1/1/1970, UTC
+ */
+bool RTC_TimeZone::isDST(uint32_t utc) const {
+    if (_count == 0)
+        return false;
+    uint32_t t = utc < SECONDS_FROM_1970_TO_2000 ? 0 : utc - SECONDS_FROM_1970_TO_2000;
+    uint8_t i = upperBound(t);
+    if (i == 0) // before the first transition: the opposite of it
+        return !(entry(0) & 1);
+    return entry(i - 1) & 1;
+}
+
+/**
+ * @brief Convert local time to UTC
+ *
+ * Local times that occur twice when DST ends are taken as daylight time;
+ * local times skipped when DST begins are converted with the standard offset.
+ *
+ * @param local Local seconds since 1/1/1970
+ */
+uint32_t RTC_TimeZone::toUTC(uint32_t local) const {
+    uint32_t utc = local - _dstOffset * 60L;
+    if (isDST(utc))
+        return utc;
+    return local - _stdOffset * 60L;
+}
+
+DateTime RTC_TimeZone::toLocal(const DateTime &utc) const {
+    return DateTime(toLocal(utc.unixtime()));
+}
+
+/**
+ * @brief Convert a local time, e.g. an alarm time, to UTC
+ * @see toUTC(uint32_t)
+ */
+DateTime RTC_TimeZone::toUTC(const DateTime &local) const {
+    return DateTime(toUTC(local.unixtime()));
+}
+
+/**
+ * @brief When does the offset change next?
+ *
+ * Useful for rescheduling alarms that are set in local time.
+ *
+ * @param utc Seconds since 1/1/1970, UTC
+ * @return Seconds since 1/1/1970 of the next transition, or 0 if none
+ */
+uint32_t RTC_TimeZone::nextTransition(uint32_t utc) const {
+    uint32_t t = utc < SECONDS_FROM_1970_TO_2000 ? 0 : utc - SECONDS_FROM_1970_TO_2000;
+    uint8_t i = upperBound(t);
+    if (i >= _count)
+        return 0;
+    return (entry(i) & ~1UL) + SECONDS_FROM_1970_TO_2000;
+}
@@ -0,0 +1,150 @@
+// Time zone and daylight saving time conversion
+// Released to the public domain! Enjoy!
+//
+// The DST rules of a zone are given at compile time and expanded by the
+// compiler into a table of every transition from 2000 to 2099, stored in
+// flash. Converting between UTC and local time is then a binary search of
+// that table (8 comparisons) instead of re-evaluating the rules.
+//
+//   // US Eastern: UTC-5, DST from the 2nd Sunday in March at 2:00 to the
+//   // 1st Sunday in November at 2:00 (local time)
+//   RTC_TIMEZONE(usEastern, -300, -240,
+//                RtcTzRule(2, RTC_TZ_SUN, 3, 2), RtcTzRule(1, RTC_TZ_SUN, 11, 2));
+//
+//   // Central European Time: UTC+1, DST from the last Sunday in March at
+//   // 2:00 to the last Sunday in October at 3:00 (local time)
+//   RTC_TIMEZONE(cet, 60, 120,
+//                RtcTzRule(RTC_TZ_LAST, RTC_TZ_SUN, 3, 2), RtcTzRule(RTC_TZ_LAST, RTC_TZ_SUN, 10, 3));
+//
+//   DateTime local = cet.toLocal(rtc.now());
+//
+// NOTE: one pair of rules is applied to the whole century, so historical
+// rule changes (e.g. the US change in 2007) are not represented.
+
+#ifndef _RTC_TIMEZONE_H_
+#define _RTC_TIMEZONE_H_
+
+#include "RTClibExtended.h"
+
+#define RTC_TZ_LAST                  5       // week number meaning "last in month"
+
+#define RTC_TZ_SUN                   0
+#define RTC_TZ_MON                   1
+#define RTC_TZ_TUE                   2
+#define RTC_TZ_WED                   3
+#define RTC_TZ_THU                   4
+#define RTC_TZ_FRI                   5
+#define RTC_TZ_SAT                   6
+
+// When a transition happens: the week'th (1..4 or RTC_TZ_LAST) dayOfWeek of
+// month, at hour local time (in the offset that is in effect before it).
+struct RtcTzRule {
+    constexpr RtcTzRule(uint8_t week, uint8_t dayOfWeek, uint8_t month, uint8_t hour) :
+            week(week), dow(dayOfWeek), month(month), hour(hour) {}
+    uint8_t week, dow, month, hour;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Compile-time transition arithmetic. Days and seconds count from 1/1/2000,
+// as DateTime::secondstime() does.
+
+// days from 1/1/2000 to the first of month m in year y (y = 0..99)
+constexpr uint16_t rtcTzMonthStart(uint8_t y, uint8_t m) {
+    return m > 12 ? rtcTzMonthStart(y + 1, 1)
+                  : 365 * y + (y + 3) / 4 + (367 * m - 362) / 12 - (m > 2 ? (y % 4 == 0 ? 1 : 2) : 0);
+}
+
+// day of the week, 0 = Sunday; 1/1/2000 was a Saturday
+constexpr uint8_t rtcTzDow(uint16_t days) {
+    return (days + 6) % 7;
+}
+
+constexpr uint16_t rtcTzFirstDow(uint16_t first, uint8_t dow) {
+    return first + (dow + 7 - rtcTzDow(first)) % 7;
+}
+
+constexpr uint16_t rtcTzLastDow(uint16_t last, uint8_t dow) {
+    return last - (rtcTzDow(last) + 7 - dow) % 7;
+}
+
+constexpr uint16_t rtcTzDay(uint8_t y, const RtcTzRule &r) {
+    return r.week == RTC_TZ_LAST ? rtcTzLastDow(rtcTzMonthStart(y, r.month + 1) - 1, r.dow)
+                                 : rtcTzFirstDow(rtcTzMonthStart(y, r.month), r.dow) + 7 * (r.week - 1);
+}
+
+// UTC seconds of the transition; offsetBefore is the UTC offset in minutes
+// in effect before it
+constexpr uint32_t rtcTzTransition(uint8_t y, const RtcTzRule &r, int16_t offsetBefore) {
+    return rtcTzDay(y, r) * 86400UL + r.hour * 3600UL - (int32_t) offsetBefore * 60;
+}
+
+// Table entries are UTC seconds with bit 0 set where DST begins (transitions
+// are on whole minutes, so bit 0 is free). The two of a year are sorted,
+// which puts the end of DST first in the southern hemisphere.
+constexpr uint32_t rtcTzFirst(uint32_t start, uint32_t end) {
+    return start < end ? (start | 1) : end;
+}
+
+constexpr uint32_t rtcTzSecond(uint32_t start, uint32_t end) {
+    return start < end ? end : (start | 1);
+}
+
+#define RTC_TZ_YEAR(y, start, end, std, dst) \
+    rtcTzFirst(rtcTzTransition(y, start, std), rtcTzTransition(y, end, dst)), \
+    rtcTzSecond(rtcTzTransition(y, start, std), rtcTzTransition(y, end, dst)),
+
+#define RTC_TZ_DECADE(d, start, end, std, dst) \
+    RTC_TZ_YEAR(d + 0, start, end, std, dst) RTC_TZ_YEAR(d + 1, start, end, std, dst) \
+    RTC_TZ_YEAR(d + 2, start, end, std, dst) RTC_TZ_YEAR(d + 3, start, end, std, dst) \
+    RTC_TZ_YEAR(d + 4, start, end, std, dst) RTC_TZ_YEAR(d + 5, start, end, std, dst) \
+    RTC_TZ_YEAR(d + 6, start, end, std, dst) RTC_TZ_YEAR(d + 7, start, end, std, dst) \
+    RTC_TZ_YEAR(d + 8, start, end, std, dst) RTC_TZ_YEAR(d + 9, start, end, std, dst)
+
+#define RTC_TZ_CENTURY(start, end, std, dst) \
+    RTC_TZ_DECADE(0, start, end, std, dst) RTC_TZ_DECADE(10, start, end, std, dst) \
+    RTC_TZ_DECADE(20, start, end, std, dst) RTC_TZ_DECADE(30, start, end, std, dst) \
+    RTC_TZ_DECADE(40, start, end, std, dst) RTC_TZ_DECADE(50, start, end, std, dst) \
+    RTC_TZ_DECADE(60, start, end, std, dst) RTC_TZ_DECADE(70, start, end, std, dst) \
+    RTC_TZ_DECADE(80, start, end, std, dst) RTC_TZ_DECADE(90, start, end, std, dst)
+
+#define RTC_TZ_TRANSITIONS           200
+
+// Define a zone called name with standard and daylight offsets in minutes
+// east of UTC and the rules for the start and end of DST. The 800 byte
+// transition table goes in flash.
+#define RTC_TIMEZONE(name, stdOffset, dstOffset, startRule, endRule) \
+    const uint32_t name##_transitions[RTC_TZ_TRANSITIONS] PROGMEM = { \
+        RTC_TZ_CENTURY(startRule, endRule, stdOffset, dstOffset) }; \
+    RTC_TimeZone name(name##_transitions, RTC_TZ_TRANSITIONS, stdOffset, dstOffset)
+
+// A zone without daylight saving time
+#define RTC_FIXED_TIMEZONE(name, offset) \
+    RTC_TimeZone name(0, 0, offset, offset)
+
+class RTC_TimeZone {
+public:
+    RTC_TimeZone(const uint32_t* transitions, uint8_t count, int16_t stdOffset, int16_t dstOffset);
+
+    bool isDST(uint32_t utc) const;
+    // Offset from UTC in minutes
+    int16_t offset(uint32_t utc) const      { return isDST(utc) ? _dstOffset : _stdOffset; }
+
+    uint32_t toLocal(uint32_t utc) const    { return utc + offset(utc) * 60L; }
+    uint32_t toUTC(uint32_t local) const;
+    DateTime toLocal(const DateTime& utc) const;
+    DateTime toUTC(const DateTime& local) const;
+
+    // The next change of offset after utc, or 0 if there is none before 2100
+    uint32_t nextTransition(uint32_t utc) const;
+
+protected:
+    uint8_t upperBound(uint32_t t) const;
+    uint32_t entry(uint8_t i) const;
+
+    const uint32_t* _transitions;
+    uint8_t _count;
+    int16_t _stdOffset;
+    int16_t _dstOffset;
+};
+
+#endif // _RTC_TIMEZONE_H_
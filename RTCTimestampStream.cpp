@@ -0,0 +1,245 @@
+// Compact binary encoding of timestamp sequences
+// Released to the public domain! Enjoy!
+
+#include "RTCTimestampStream.h"
+
+static inline uint32_t zigzag(int32_t v) { return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31); }
+
+static inline int32_t unzigzag(uint32_t v) { return (int32_t) (v >> 1) ^ -(int32_t) (v & 1); }
+
+static uint8_t put_varint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t) v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (uint8_t) v;
+    return n;
+}
+
+// Reads a varint of at most 5 bytes (all a 32 bit value needs) before end;
+// false if it runs past end or is longer, i.e. the stream is corrupt
+static inline bool get_varint(const uint8_t *buf, size_t &pos, size_t end, uint32_t &v) {
+    if (pos >= end)
+        return false;
+    uint8_t b = buf[pos++];
+    v = b;
+    if (!(b & 0x80))
+        return true;
+    v &= 0x7F;
+    for (uint8_t shift = 7; shift < 35; shift += 7) {
+        if (pos >= end)
+            return false;
+        b = buf[pos++];
+        v |= (uint32_t) (b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return p[0] | (uint16_t) p[1] << 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return get_le16(p) | (uint32_t) get_le16(p + 2) << 16;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_TimestampEncoder implementation
+
+/**
+ * @brief A stream writer over a caller supplied buffer
+ *
+ * @param buf The buffer; it must outlive the encoder
+ * @param capacity Size of buf in bytes, at least RTC_TS_HEADER_SIZE
+ * @param interval Records per block; smaller values seek faster but cost
+ * 5 or 7 extra bytes per block
+ * @param temps True to store a temperature with every timestamp
+ */
+RTC_TimestampEncoder::RTC_TimestampEncoder(uint8_t *buf, size_t capacity, uint8_t interval, bool temps) :
+        _buf(buf),
+        _capacity(capacity),
+        _interval(interval ? interval : 1),
+        _temps(temps) {
+    reset();
+}
+
+/**
+ * @brief Discard the contents and start a new stream with its header
+ */
+void RTC_TimestampEncoder::reset() {
+    _len = 0;
+    _block = 0;
+    _count = 0;
+    _inBlock = 0;
+    _prevTime = 0;
+    _prevTemp = 0;
+    if (_capacity < RTC_TS_HEADER_SIZE)
+        return;
+    _buf[0] = RTC_TS_MAGIC;
+    _buf[1] = RTC_TS_VERSION;
+    _buf[2] = _temps ? RTC_TS_TEMPS : 0;
+    _buf[3] = _interval;
+    _len = RTC_TS_HEADER_SIZE;
+}
+
+/**
+ * @brief Add one record
+ *
+ * @param t Seconds since 1/1/1970
+ * @param tempQuarter Temperature in quarter degrees C; ignored unless the
+ * encoder was made with temps
+ * @return False, leaving the buffer unchanged, if the record does not fit
+ */
+bool RTC_TimestampEncoder::append(uint32_t t, int16_t tempQuarter) {
+    if (_len < RTC_TS_HEADER_SIZE)
+        return false;
+
+    uint8_t rec[10];
+    uint8_t n = 0;
+    bool key = _inBlock == 0;
+    if (key) {
+        put_le16(rec, 0);
+        put_le32(rec + 2, t);
+        n = 6;
+        if (_temps) {
+            put_le16(rec + n, tempQuarter);
+            n += 2;
+        }
+    } else {
+        n = put_varint(rec, zigzag((int32_t) (t - _prevTime)));
+        if (_temps)
+            n += put_varint(rec + n, zigzag(tempQuarter - _prevTemp));
+    }
+    if (_len + n > _capacity)
+        return false;
+
+    memcpy(_buf + _len, rec, n);
+    if (key)
+        _block = _len;
+    _len += n;
+    if (!key)
+        put_le16(_buf + _block, _len - _block - (_temps ? 8 : 6));
+
+    _prevTime = t;
+    _prevTemp = tempQuarter;
+    ++_count;
+    if (++_inBlock == _interval)
+        _inBlock = 0;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RTC_TimestampDecoder implementation
+
+RTC_TimestampDecoder::RTC_TimestampDecoder(const uint8_t *buf, size_t length) :
+        _buf(buf),
+        _len(length) {
+    _valid = length >= RTC_TS_HEADER_SIZE && buf[0] == RTC_TS_MAGIC && buf[1] == RTC_TS_VERSION;
+    _temps = _valid && (buf[2] & RTC_TS_TEMPS);
+    rewind();
+}
+
+/**
+ * @brief Go back to the first record
+ */
+void RTC_TimestampDecoder::rewind() {
+    _pos = RTC_TS_HEADER_SIZE;
+    _blockEnd = _pos;
+    _key = true;
+    _time = 0;
+    _temp = 0;
+}
+
+// Read the keyframe of the block at pos
+bool RTC_TimestampDecoder::readBlock(size_t pos) {
+    size_t keySize = _temps ? 8 : 6;
+    if (pos + keySize > _len)
+        return false;
+
+    const uint8_t *p = _buf + pos;
+    _time = get_le32(p + 2);
+    _temp = _temps ? (int16_t) get_le16(p + 6) : 0;
+    _pos = pos + keySize;
+    _blockEnd = _pos + get_le16(p);
+    if (_blockEnd > _len)
+        _blockEnd = _len;
+    _key = false;
+    return true;
+}
+
+/**
+ * @brief Decode the next record
+ *
+ * @param t Set to the time, seconds since 1/1/1970
+ * @param tempQuarter Set to the temperature in quarter degrees C (0 if the
+ * stream has none)
+ * @return False at the end of the stream or if it is truncated or corrupt
+ */
+bool RTC_TimestampDecoder::next(uint32_t &t, int16_t &tempQuarter) {
+    if (!_valid)
+        return false;
+
+    if (_key || _pos >= _blockEnd) {
+        if (!readBlock(_key ? _pos : _blockEnd))
+            return false;
+    } else {
+        uint32_t v;
+        if (!get_varint(_buf, _pos, _blockEnd, v))
+            return false;
+        _time += unzigzag(v);
+        if (_temps) {
+            if (!get_varint(_buf, _pos, _blockEnd, v))
+                return false;
+            _temp += unzigzag(v);
+        }
+    }
+
+    t = _time;
+    tempQuarter = _temp;
+    return true;
+}
+
+/**
+ * @brief Skip to the block that holds time t
+ *
+ * Hops from keyframe to keyframe using the block lengths, without decoding
+ * the deltas. The next call to next() returns the keyframe of the last block
+ * that starts at or before t (or the first block); keep calling next() to
+ * reach t itself. Assumes the keyframes are in time order.
+ *
+ * @param t Seconds since 1/1/1970
+ * @return False if the stream is empty or not valid
+ */
+bool RTC_TimestampDecoder::seek(uint32_t t) {
+    rewind();
+    if (!_valid)
+        return false;
+
+    size_t keySize = _temps ? 8 : 6;
+    size_t pos = RTC_TS_HEADER_SIZE, found = pos;
+    if (pos + keySize > _len)
+        return false;
+    while (pos + keySize <= _len) {
+        const uint8_t *p = _buf + pos;
+        if (get_le32(p + 2) > t)
+            break;
+        found = pos;
+        pos += keySize + get_le16(p);
+    }
+    _pos = found;
+    _key = true;
+    return true;
+}
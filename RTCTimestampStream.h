@@ -0,0 +1,80 @@
+// Compact binary encoding of timestamp sequences
+// Released to the public domain! Enjoy!
+//
+// Stream layout (all multi-byte fields little-endian):
+//
+//   header:  'T' 0x01 flags interval           flags bit 0: temperatures present
+//   block:   length(2) time(4) [temp(2)] delta...
+//   delta:   zig-zag varint of the time difference [zig-zag varint of the
+//            temperature difference]
+//
+// A block starts with a full keyframe every `interval` records; length is the
+// number of delta bytes that follow the keyframe, so a reader can hop from
+// keyframe to keyframe without decoding the deltas. Samples a few seconds
+// apart take one byte each (two with temperatures).
+
+#ifndef _RTC_TIMESTAMP_STREAM_H_
+#define _RTC_TIMESTAMP_STREAM_H_
+
+#include "RTClibExtended.h"
+
+#define RTC_TS_MAGIC                 'T'
+#define RTC_TS_VERSION               0x01
+#define RTC_TS_TEMPS                 0x01
+#define RTC_TS_HEADER_SIZE           4
+
+// Writes a stream into a fixed buffer. When append() returns false the
+// buffer is full: save data()/length() (e.g. to flash or the radio) and call
+// reset() to start a new, independent stream.
+class RTC_TimestampEncoder {
+public:
+    RTC_TimestampEncoder(uint8_t* buf, size_t capacity, uint8_t interval = 32, bool temps = false);
+
+    void reset();
+    bool append(uint32_t t, int16_t tempQuarter = 0);
+    bool append(const DateTime& dt, int16_t tempQuarter = 0) { return append(dt.unixtime(), tempQuarter); }
+
+    const uint8_t* data() const     { return _buf; }
+    size_t length() const           { return _len; }
+    uint32_t count() const          { return _count; }
+
+protected:
+    uint8_t* _buf;
+    size_t _capacity;
+    size_t _len;
+    size_t _block;          // offset of the current block's length field
+    uint32_t _count;
+    uint8_t _inBlock;       // records in the current block
+    uint8_t _interval;
+    bool _temps;
+    uint32_t _prevTime;
+    int16_t _prevTemp;
+};
+
+// Reads a stream made by RTC_TimestampEncoder
+class RTC_TimestampDecoder {
+public:
+    RTC_TimestampDecoder(const uint8_t* buf, size_t length);
+
+    bool valid() const              { return _valid; }
+    bool hasTemps() const           { return _temps; }
+    void rewind();
+    bool next(uint32_t& t, int16_t& tempQuarter);
+    bool next(uint32_t& t)          { int16_t temp; return next(t, temp); }
+    bool seek(uint32_t t);
+
+protected:
+    bool readBlock(size_t pos);
+
+    const uint8_t* _buf;
+    size_t _len;
+    size_t _pos;
+    size_t _blockEnd;
+    bool _valid;
+    bool _temps;
+    bool _key;              // next record is the keyframe at _pos
+    uint32_t _time;
+    int16_t _temp;
+};
+
+#endif // _RTC_TIMESTAMP_STREAM_H_
@@ -30,6 +30,86 @@
 #define _I2C_READ  receive
 #endif
 
+#include "RTCInstrumentation.h"
+
+#ifdef RTCLIB_INSTRUMENT
+// Route every bus access in this file through the counting proxy
+static RTC_WireProbe<TwoWire> rtc_wire(Wire);
+#undef Wire
+#define Wire rtc_wire
+#endif
+
+#ifdef __AVR__
+#define RTC_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+#define RTC_BARRIER() __sync_synchronize()
+#endif
+
+// True in an interrupt handler. On AVR that is taken as interrupts being
+// off, in which case Wire would hang anyway; Cortex-M reads IPSR. Other
+// cores can define RTC_IN_ISR() in the build flags.
+#ifndef RTC_IN_ISR
+#if defined(__AVR__)
+#define RTC_IN_ISR() (!(SREG & _BV(SREG_I)))
+#elif defined(__arm__) && defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'
+static inline bool rtc_in_isr() {
+    uint32_t ipsr;
+    __asm__ __volatile__("mrs %0, ipsr" : "=r"(ipsr));
+    return ipsr != 0;
+}
+#define RTC_IN_ISR() rtc_in_isr()
+#elif defined(ESP32)
+#define RTC_IN_ISR() xPortInIsrContext()
+#else
+#define RTC_IN_ISR() false
+#endif
+#endif
+
+// Set while an RTC_DS3231 method owns the bus
+static volatile bool rtc_bus_busy = false;
+static volatile uint16_t rtc_bus_rejections = 0;
+
+static bool rtc_bus_acquire() {
+    if (RTC_IN_ISR())
+        return false;
+#ifdef __AVR__
+    uint8_t sreg = SREG;
+    cli();
+    bool acquired = !rtc_bus_busy;
+    rtc_bus_busy = true;
+    SREG = sreg;
+    return acquired;
+#else
+    return !__atomic_test_and_set((bool *) &rtc_bus_busy, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void rtc_bus_release() {
+#ifdef __AVR__
+    rtc_bus_busy = false;
+#else
+    __atomic_clear((bool *) &rtc_bus_busy, __ATOMIC_RELEASE);
+#endif
+}
+
+// Holds the bus for the rest of a method, see RTC_BUS_GUARD
+class RTC_BusGuard {
+public:
+    RTC_BusGuard() : acquired(rtc_bus_acquire()) {}
+    ~RTC_BusGuard() { if (acquired) rtc_bus_release(); }
+    const bool acquired;
+};
+
+// Refuse to start a bus transaction from an ISR or inside another one, e.g.
+// from a callback that interrupted loop() in the middle of a Wire sequence,
+// and return `rejected` instead. Guarded methods must not call each other.
+#define RTC_BUS_GUARD(rejected) \
+    RTC_BusGuard _rtc_guard; \
+    if (!_rtc_guard.acquired) { \
+        rtc_bus_rejections = rtc_bus_rejections + 1; \
+        return rejected; \
+    }
+
 /**
  * @brief Read information from a device's register
  * @param addr The device address  on the I2C bus
@@ -64,7 +144,7 @@ static void write_i2c_register(uint8_t addr, uint8_t reg, uint8_t val) {
 
 const uint8_t daysInMonth[] PROGMEM = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
-// number of days since 2000/01/01, valid for 2001..2099
+// number of days since 2000/01/01, valid for 2000..2099
 static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
     if (y >= 2000)
         y -= 2000;
@@ -78,8 +158,9 @@ static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
     return days + 365 * y + (y + 3) / 4 - 1;
 }
 
-static long time2long(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
-    return ((days * 24L + h) * 60 + m) * 60 + s;
+// unsigned, so dates after 2068 do not overflow where long is 32 bits (AVR)
+static uint32_t time2long(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
+    return ((days * 24UL + h) * 60 + m) * 60 + s;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -290,6 +371,111 @@ TimeSpan TimeSpan::operator-(const TimeSpan &right) {
     return TimeSpan(_seconds - right._seconds);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// TimeSpanFields implementation
+
+/**
+ * @brief Split a span into days, hours, minutes and seconds
+ *
+ * Uses reciprocal multiplications that are exact over the ranges involved
+ * (checked exhaustively): 16x16 bit products, which AVR does in hardware,
+ * instead of 32-bit division and modulo, which it does in software.
+ *
+ * @param span The span to split
+ */
+TimeSpanFields::TimeSpanFields(const TimeSpan &span) {
+    int32_t s = span.totalseconds();
+    uint32_t a = s < 0 ? -(uint32_t) s : (uint32_t) s;
+
+    // days: 86400 = 128 * 675 and 24855 / 2^16 ~ 256 / 675; the estimate
+    // is low by at most two, fixed up below
+    uint16_t d = ((uint32_t) (uint16_t) (a >> 15) * 24855UL) >> 16;
+    uint32_t r = a - d * 86400UL;
+    while (r >= 86400UL) {
+        ++d;
+        r -= 86400UL;
+    }
+
+    // hours: 3600 = 16 * 225, x / 225 == x * 4661 >> 20 for x < 5400
+    uint8_t h = ((uint16_t) (r >> 4) * 4661UL) >> 20;
+    uint16_t r2 = r - h * 3600UL;
+    // minutes: x / 60 == x * 2185 >> 17 for x < 3600
+    uint8_t m = (r2 * 2185UL) >> 17;
+    uint8_t sec = r2 - m * 60;
+
+    if (s < 0) {
+        _days = -(int16_t) d;
+        _hours = -(int8_t) h;
+        _minutes = -(int8_t) m;
+        _seconds = -(int8_t) sec;
+    } else {
+        _days = d;
+        _hours = h;
+        _minutes = m;
+        _seconds = sec;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Ds3231TempStats implementation
+
+Ds3231TempStats::Ds3231TempStats(uint16_t window) :
+        _window(window ? window : 1) {
+    reset();
+}
+
+void Ds3231TempStats::reset() {
+    _n = 0;
+    _mean = 0;
+    _m2 = 0;
+    _min = _winMin = _prevMin = INT16_MAX;
+    _max = _winMax = _prevMax = INT16_MIN;
+    _winCount = 0;
+}
+
+/**
+ * @brief Add one sample
+ * @param tempQuarter Temperature in quarter degrees C, e.g. from the DS3231
+ * temperature registers
+ */
+void Ds3231TempStats::add(int16_t tempQuarter) {
+    int32_t x = (int32_t) tempQuarter * 65536L;
+    ++_n;
+    int32_t delta = x - _mean;
+    // round rather than truncate, so the mean does not creep over long runs
+    int32_t half = _n / 2;
+    _mean += (delta + (delta >= 0 ? half : -half)) / (int32_t) _n;
+    _m2 += (int64_t) delta * (x - _mean);
+
+    if (tempQuarter < _min)
+        _min = tempQuarter;
+    if (tempQuarter > _max)
+        _max = tempQuarter;
+
+    if (_winCount == _window) {
+        _prevMin = _winMin;
+        _prevMax = _winMax;
+        _winMin = INT16_MAX;
+        _winMax = INT16_MIN;
+        _winCount = 0;
+    }
+    if (tempQuarter < _winMin)
+        _winMin = tempQuarter;
+    if (tempQuarter > _winMax)
+        _winMax = tempQuarter;
+    ++_winCount;
+}
+
+/**
+ * @brief Sample variance in degrees C squared; 0 for fewer than two samples
+ */
+float Ds3231TempStats::variance() const {
+    if (_n < 2)
+        return 0;
+    // Q32 quarter degrees squared -> degrees squared
+    return (float) (_m2 / (int64_t) (_n - 1)) / (4294967296.0 * 16.0);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // RTC_DS1307 implementation
 
@@ -298,11 +484,13 @@ static uint8_t bcd2bin(uint8_t val) { return val - 6 * (val >> 4); }
 static uint8_t bin2bcd(uint8_t val) { return val + 6 * (val / 10); }
 
 boolean RTC_DS1307::begin(void) {
+    RTC_PROBE(DS1307_BEGIN);
     Wire.begin();
     return true;
 }
 
 uint8_t RTC_DS1307::isrunning(void) {
+    RTC_PROBE(DS1307_ISRUNNING);
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE((byte) 0);
     Wire.endTransmission();
@@ -313,6 +501,7 @@ uint8_t RTC_DS1307::isrunning(void) {
 }
 
 void RTC_DS1307::adjust(const DateTime &dt) {
+    RTC_PROBE(DS1307_ADJUST);
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE((byte) 0); // start at location 0
     Wire._I2C_WRITE(bin2bcd(dt.second()));
@@ -326,6 +515,7 @@ void RTC_DS1307::adjust(const DateTime &dt) {
 }
 
 DateTime RTC_DS1307::now() {
+    RTC_PROBE(DS1307_NOW);
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE((byte) 0);
     Wire.endTransmission();
@@ -343,6 +533,7 @@ DateTime RTC_DS1307::now() {
 }
 
 Ds1307SqwPinMode RTC_DS1307::readSqwPinMode() {
+    RTC_PROBE(DS1307_READSQWPINMODE);
     int mode;
 
     Wire.beginTransmission(DS1307_ADDRESS);
@@ -357,6 +548,7 @@ Ds1307SqwPinMode RTC_DS1307::readSqwPinMode() {
 }
 
 void RTC_DS1307::writeSqwPinMode(Ds1307SqwPinMode mode) {
+    RTC_PROBE(DS1307_WRITESQWPINMODE);
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE(DS1307_CONTROL);
     Wire._I2C_WRITE(mode);
@@ -364,6 +556,7 @@ void RTC_DS1307::writeSqwPinMode(Ds1307SqwPinMode mode) {
 }
 
 void RTC_DS1307::readnvram(uint8_t *buf, uint8_t size, uint8_t address) {
+    RTC_PROBE(DS1307_READNVRAM);
     int addrByte = DS1307_NVRAM + address;
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE(addrByte);
@@ -376,6 +569,7 @@ void RTC_DS1307::readnvram(uint8_t *buf, uint8_t size, uint8_t address) {
 }
 
 void RTC_DS1307::writenvram(uint8_t address, uint8_t *buf, uint8_t size) {
+    RTC_PROBE(DS1307_WRITENVRAM);
     int addrByte = DS1307_NVRAM + address;
     Wire.beginTransmission(DS1307_ADDRESS);
     Wire._I2C_WRITE(addrByte);
@@ -414,11 +608,13 @@ DateTime RTC_Millis::now() {
 // RTC_PCF8563 implementation
 
 boolean RTC_PCF8523::begin(void) {
+    RTC_PROBE(PCF8523_BEGIN);
     Wire.begin();
     return true;
 }
 
 boolean RTC_PCF8523::initialized(void) {
+    RTC_PROBE(PCF8523_INITIALIZED);
     Wire.beginTransmission(PCF8523_ADDRESS);
     Wire._I2C_WRITE((byte) PCF8523_CONTROL_3);
     Wire.endTransmission();
@@ -429,6 +625,7 @@ boolean RTC_PCF8523::initialized(void) {
 }
 
 void RTC_PCF8523::adjust(const DateTime &dt) {
+    RTC_PROBE(PCF8523_ADJUST);
     Wire.beginTransmission(PCF8523_ADDRESS);
     Wire._I2C_WRITE((byte) 3); // start at location 3
     Wire._I2C_WRITE(bin2bcd(dt.second()));
@@ -448,6 +645,7 @@ void RTC_PCF8523::adjust(const DateTime &dt) {
 }
 
 DateTime RTC_PCF8523::now() {
+    RTC_PROBE(PCF8523_NOW);
     Wire.beginTransmission(PCF8523_ADDRESS);
     Wire._I2C_WRITE((byte) 3);
     Wire.endTransmission();
@@ -465,6 +663,7 @@ DateTime RTC_PCF8523::now() {
 }
 
 Pcf8523SqwPinMode RTC_PCF8523::readSqwPinMode() {
+    RTC_PROBE(PCF8523_READSQWPINMODE);
     int mode;
 
     Wire.beginTransmission(PCF8523_ADDRESS);
@@ -479,26 +678,175 @@ Pcf8523SqwPinMode RTC_PCF8523::readSqwPinMode() {
     return static_cast<Pcf8523SqwPinMode>(mode);
 }
 
+/**
+ * @brief Set the CLKOUT frequency
+ *
+ * Only the COF bits of Tmr_CLKOUT_ctrl are changed, so running countdown
+ * timers are left alone. Timer interrupts need PCF8523_OFF.
+ *
+ * @param mode One of Pcf8523SqwPinMode
+ */
 void RTC_PCF8523::writeSqwPinMode(Pcf8523SqwPinMode mode) {
+    RTC_PROBE(PCF8523_WRITESQWPINMODE);
+    uint8_t ctrl = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+    ctrl &= ~0x38; // clear COF bits (b 0011 1000)
+    ctrl |= mode << 3;
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, ctrl);
+}
+
+/**
+ * @brief Start a countdown timer for periodic interrupts
+ *
+ * The timer reloads itself, so a fixed-rate wake-up needs no bus traffic
+ * per period: in pulse mode INT1 pulses low every numPeriods ticks without
+ * the flag being cleared. In permanent mode INT1 stays low until
+ * clearCountdownFlag() is called.
+ *
+ * @param timer PCF8523_TimerA or PCF8523_TimerB
+ * @param clkFreq The source clock, 4.096kHz down to 1/3600Hz
+ * @param numPeriods Ticks per period, 1..255
+ * @param pulse True for a pulsed interrupt (TAM/TBM set), false for a
+ * permanent one that follows the flag
+ * @param pulseWidth Pulse width; timer B only
+ *
+ * @note INT1 is shared with CLKOUT; call writeSqwPinMode(PCF8523_OFF) first.
+ */
+void RTC_PCF8523::enableCountdownTimer(Pcf8523Timer timer, Pcf8523TimerClockFreq clkFreq, uint8_t numPeriods,
+                                       bool pulse, Pcf8523TimerIntPulse pulseWidth) {
+    RTC_PROBE(PCF8523_ENABLECOUNTDOWNTIMER);
+    bool a = timer == PCF8523_TimerA;
+
+    // source clock and period in one burst, before the timer is enabled
     Wire.beginTransmission(PCF8523_ADDRESS);
-    Wire._I2C_WRITE(PCF8523_CLKOUTCONTROL);
-    Wire._I2C_WRITE(mode << 3);
+    Wire._I2C_WRITE((byte) (a ? PCF8523_TIMER_A_FRCTL : PCF8523_TIMER_B_FRCTL));
+    Wire._I2C_WRITE((byte) (a ? clkFreq : (pulseWidth << 4) | clkFreq));
+    Wire._I2C_WRITE(numPeriods);
     Wire.endTransmission();
+
+    // enable the interrupt and clear a stale flag; writing 1 to a flag has no
+    // effect, so CTAF, CTBF, SF and AF are written as 1 to keep the others
+    uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+    ctrl2 |= 0x78;
+    ctrl2 &= a ? ~0x40 : ~0x20;     // CTAF / CTBF
+    ctrl2 |= a ? 0x02 : 0x01;       // CTAIE / CTBIE
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, ctrl2);
+
+    uint8_t ctrl = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+    if (a) {
+        ctrl &= ~0x86;              // TAM, TAC
+        ctrl |= 0x02;               // TAC = 01: countdown timer
+        if (pulse)
+            ctrl |= 0x80;           // TAM = 1: pulsed
+    } else {
+        ctrl &= ~0x40;              // TBM
+        ctrl |= 0x01;               // TBC
+        if (pulse)
+            ctrl |= 0x40;           // TBM = 1: pulsed
+    }
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, ctrl);
+}
+
+/**
+ * @brief Stop a countdown timer and disable its interrupt
+ */
+void RTC_PCF8523::disableCountdownTimer(Pcf8523Timer timer) {
+    RTC_PROBE(PCF8523_DISABLECOUNTDOWNTIMER);
+    bool a = timer == PCF8523_TimerA;
+
+    uint8_t ctrl = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+    ctrl &= a ? ~0x06 : ~0x01;
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, ctrl);
+
+    uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+    ctrl2 |= 0x78;
+    ctrl2 &= a ? ~0x42 : ~0x21;
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, ctrl2);
+}
+
+/**
+ * @brief Has the timer expired since its flag was last cleared?
+ */
+bool RTC_PCF8523::countdownFired(Pcf8523Timer timer) {
+    RTC_PROBE(PCF8523_COUNTDOWNFIRED);
+    uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+    return ctrl2 & (timer == PCF8523_TimerA ? 0x40 : 0x20);
+}
+
+/**
+ * @brief Clear the timer flag, releasing INT1 in permanent mode
+ */
+void RTC_PCF8523::clearCountdownFlag(Pcf8523Timer timer) {
+    RTC_PROBE(PCF8523_CLEARCOUNTDOWNFLAG);
+    uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+    ctrl2 |= 0x78;
+    ctrl2 &= timer == PCF8523_TimerA ? ~0x40 : ~0x20;
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, ctrl2);
+}
+
+/**
+ * @brief Write the offset (aging correction) register
+ *
+ * @param mode How often the correction is applied
+ * @param offset Correction in steps of 4.34 ppm (PCF8523_TwoHours) or
+ * 4.069 ppm (PCF8523_OneMinute), -64..63; positive values speed the clock up
+ */
+void RTC_PCF8523::writeOffset(Pcf8523OffsetMode mode, int8_t offset) {
+    RTC_PROBE(PCF8523_WRITEOFFSET);
+    write_i2c_register(PCF8523_ADDRESS, PCF8523_OFFSET, (offset & 0x7F) | mode);
+}
+
+/**
+ * @brief Read the offset register
+ *
+ * @param mode Set to the correction mode
+ * @return The signed 7 bit correction
+ */
+int8_t RTC_PCF8523::readOffset(Pcf8523OffsetMode &mode) {
+    RTC_PROBE(PCF8523_READOFFSET);
+    uint8_t value = read_i2c_register(PCF8523_ADDRESS, PCF8523_OFFSET);
+    mode = static_cast<Pcf8523OffsetMode>(value & 0x80);
+    // sign-extend bit 6
+    return (int8_t) (value << 1) >> 1;
+}
+
+/**
+ * @brief Cancel a measured drift with the offset register
+ *
+ * @param mode How often the correction is applied
+ * @param driftPpm Measured frequency error, positive if the RTC runs fast,
+ * e.g. seconds gained / seconds observed * 1000000. Pass 0 to remove the correction.
+ * @return The offset written
+ */
+int8_t RTC_PCF8523::calibrate(Pcf8523OffsetMode mode, float driftPpm) {
+    float step = mode == PCF8523_OneMinute ? 4.069 : 4.34;
+    float steps = -driftPpm / step;
+    int16_t offset = (int16_t) (steps + (steps < 0 ? -0.5 : 0.5));
+    if (offset > 63)
+        offset = 63;
+    if (offset < -64)
+        offset = -64;
+    writeOffset(mode, offset);
+    return offset;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // RTC_DS3231 implementation
 
 boolean RTC_DS3231::begin(void) {
+    RTC_PROBE(DS3231_BEGIN);
     Wire.begin();
     return true;
 }
 
 bool RTC_DS3231::lostPower(void) {
+    RTC_PROBE(DS3231_LOSTPOWER);
+    RTC_BUS_GUARD(false);
     return (read_i2c_register(DS3231_ADDRESS, DS3231_STATUSREG) >> 7);
 }
 
 void RTC_DS3231::adjust(const DateTime &dt) {
+    RTC_PROBE(DS3231_ADJUST);
+    RTC_BUS_GUARD();
     Wire.beginTransmission(DS3231_ADDRESS);
     Wire._I2C_WRITE((byte) 0); // start at location 0
     Wire._I2C_WRITE(bin2bcd(dt.second()));
@@ -515,7 +863,137 @@ void RTC_DS3231::adjust(const DateTime &dt) {
     write_i2c_register(DS3231_ADDRESS, DS3231_STATUSREG, statreg);
 }
 
+/**
+ * @brief Read the alarm, control and status registers (0x07 - 0x0F)
+ *
+ * The registers are returned ready to be written back after the time
+ * registers in a single burst: OSF cleared, A1F/A2F set because writing 1
+ * leaves a flag unchanged (so an alarm that fires before the write-back is
+ * not lost), and CONV cleared so the write-back starts no conversion.
+ *
+ * @param tail Receives the 9 register values
+ */
+static void ds3231_read_tail(uint8_t *tail) {
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire._I2C_WRITE((byte) ALM1_SECONDS);
+    Wire.endTransmission();
+
+    Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 9);
+    for (uint8_t i = 0; i < 9; ++i)
+        tail[i] = Wire._I2C_READ();
+    tail[DS3231_STATUSREG - ALM1_SECONDS] &= ~0x80; // flip OSF bit
+    tail[DS3231_STATUSREG - ALM1_SECONDS] |= 0x03;  // keep A2F and A1F
+    tail[DS3231_CONTROL - ALM1_SECONDS] &= ~0x20;   // don't set CONV
+}
+
+/**
+ * @brief Write the time and the registers from ds3231_read_tail() in one burst
+ *
+ * Writing the seconds register resets the DS3231 countdown chain, so the
+ * next seconds tick happens one second after the seconds byte is latched.
+ *
+ * @return The endTransmission() status, 0 on success
+ */
+static uint8_t ds3231_write_burst(const DateTime &dt, const uint8_t *tail) {
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire._I2C_WRITE((byte) 0); // start at location 0
+    Wire._I2C_WRITE(bin2bcd(dt.second()));
+    Wire._I2C_WRITE(bin2bcd(dt.minute()));
+    Wire._I2C_WRITE(bin2bcd(dt.hour()));
+    Wire._I2C_WRITE(bin2bcd(0));
+    Wire._I2C_WRITE(bin2bcd(dt.day()));
+    Wire._I2C_WRITE(bin2bcd(dt.month()));
+    Wire._I2C_WRITE(bin2bcd(dt.year() - 2000));
+    for (uint8_t i = 0; i < 9; ++i)
+        Wire._I2C_WRITE(tail[i]);
+    return Wire.endTransmission();
+}
+
+/**
+ * @brief Set the time with sub-second phase alignment to a reference
+ *
+ * adjust() writes the time whenever it is called, so the RTC seconds tick
+ * can be up to a second away from the reference. This method waits for the
+ * next whole reference second (minus the bus latency) and then writes the
+ * time, alarm, control and status registers in one burst, clearing OSF.
+ *
+ * @param dt The reference time, whole seconds, at the moment refMillis
+ * @param fracMs The fractional part of the reference time at refMillis, 0..999
+ * @param refMillis The millis() value at which the reference time was dt + fracMs
+ * @param latencyUs Time from endTransmission() until the seconds register is
+ * latched; raise it for slow bus clocks or lower it when using Wire.setClock(400000)
+ * @return True if the write succeeded
+ */
+bool RTC_DS3231::adjustAligned(const DateTime &dt, uint16_t fracMs, uint32_t refMillis, uint16_t latencyUs) {
+    RTC_PROBE(DS3231_ADJUSTALIGNED);
+    RTC_BUS_GUARD(false);
+    uint8_t tail[9];
+    ds3231_read_tail(tail);
+
+    uint32_t u0 = micros();
+    uint32_t trueMs = fracMs + (millis() - refMillis);
+    // Leave time for the burst setup if the next second is too close
+    uint32_t k = trueMs / 1000 + 1;
+    if (k * 1000 - trueMs < 2U + latencyUs / 1000)
+        ++k;
+    uint32_t waitUs = (k * 1000 - trueMs) * 1000 - latencyUs;
+
+    DateTime target = DateTime(dt.unixtime() + k);
+    while (micros() - u0 < waitUs)
+        ;
+
+    return ds3231_write_burst(target, tail) == 0;
+}
+
+/**
+ * @brief Set the time aligned to a pulse-per-second reference
+ *
+ * Waits for a PPS edge, then writes dt + 1 so that the seconds register is
+ * latched one second after the edge (minus the bus latency). Alarm, control
+ * and status registers go in the same burst, clearing OSF.
+ *
+ * @param dt The time at the next PPS edge
+ * @param ppsEdge Polled until it returns true; it must return true exactly
+ * once per edge (e.g. a flag set by a PPS interrupt that it clears)
+ * @param latencyUs Time from endTransmission() until the seconds register is latched
+ * @return False if no edge was seen within DS3231_PPS_TIMEOUT_MS or the write failed
+ */
+bool RTC_DS3231::adjustAligned(const DateTime &dt, bool (*ppsEdge)(void), uint16_t latencyUs) {
+    RTC_PROBE(DS3231_ADJUSTALIGNED);
+    RTC_BUS_GUARD(false);
+    uint8_t tail[9];
+    ds3231_read_tail(tail);
+
+    uint32_t start = millis();
+    while (!ppsEdge()) {
+        if (millis() - start > DS3231_PPS_TIMEOUT_MS)
+            return false;
+    }
+    uint32_t u0 = micros();
+
+    DateTime target = DateTime(dt.unixtime() + 1);
+    while (micros() - u0 < 1000000UL - latencyUs)
+        ;
+
+    return ds3231_write_burst(target, tail) == 0;
+}
+
+// now() for callers that may not use the bus
+static DateTime ds3231_cached_now() {
+    uint32_t t = RTC_DS3231::cachedUnixtime();
+    return DateTime(t ? t : (uint32_t) DS3231_CACHE_EMPTY);
+}
+
+/**
+ * @brief Read the time
+ *
+ * From an interrupt handler, or while another method holds the bus, this
+ * returns the time cached by refresh() instead, advanced by millis(), and
+ * DS3231_CACHE_EMPTY if refresh() has not succeeded yet.
+ */
 DateTime RTC_DS3231::now() {
+    RTC_PROBE(DS3231_NOW);
+    RTC_BUS_GUARD(ds3231_cached_now());
     Wire.beginTransmission(DS3231_ADDRESS);
     Wire._I2C_WRITE((byte) 0);
     Wire.endTransmission();
@@ -532,6 +1010,101 @@ DateTime RTC_DS3231::now() {
     return DateTime(y, m, d, hh, mm, ss);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// RTC_DS3231 cached time for interrupt handlers
+//
+// refresh() (main context only) publishes into two slots: it writes the slot
+// readers are not using, then bumps the sequence number to make it current.
+// An ISR that interrupts refresh() therefore still finds the previous slot
+// intact and never has to wait; on multi-core parts a reader that sees the
+// sequence change under it simply copies again.
+
+volatile uint8_t RTC_DS3231::cacheSeq = 0;
+Ds3231Snapshot RTC_DS3231::cache[2];
+
+/**
+ * @brief Read the DS3231 and publish the result for cachedNow() and friends
+ *
+ * One 19 byte burst reads the time, alarm, control, status, aging and
+ * temperature registers. Call it from loop(), e.g. once per second or from
+ * the 1Hz SQW edge flag, never from an ISR.
+ *
+ * @return False if another method was using the bus
+ */
+bool RTC_DS3231::refresh(void) {
+    RTC_PROBE(DS3231_REFRESH);
+    RTC_BUS_GUARD(false);
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire._I2C_WRITE((byte) 0);
+    Wire.endTransmission();
+
+    uint32_t stamp = millis();
+    if (Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 19) != 19)
+        return false;
+    uint8_t regs[19];
+    for (uint8_t i = 0; i < 19; ++i)
+        regs[i] = Wire._I2C_READ();
+
+    uint8_t seq = cacheSeq;
+    Ds3231Snapshot &slot = cache[(seq + 1) & 1];
+    slot.unixtime = DateTime(bcd2bin(regs[6]) + 2000, bcd2bin(regs[5]), bcd2bin(regs[4]),
+                             bcd2bin(regs[2]), bcd2bin(regs[1]), bcd2bin(regs[0] & 0x7F)).unixtime();
+    slot.millis = stamp;
+    slot.control = regs[DS3231_CONTROL];
+    slot.status = regs[DS3231_STATUSREG];
+    slot.tempQuarter = (int16_t) ((int8_t) regs[DS3231_TEMP] * 4 + (regs[DS3231_TEMP + 1] >> 6));
+    RTC_BARRIER();
+    cacheSeq = seq + 1;
+    return true;
+}
+
+/**
+ * @brief Copy the last published state; safe in interrupt handlers
+ *
+ * Lock-free and constant time on single-core parts.
+ *
+ * @param snap Set to the state published by the last refresh()
+ * @return False if refresh() has not succeeded yet
+ */
+bool RTC_DS3231::snapshot(Ds3231Snapshot &snap) {
+    uint8_t seq;
+    do {
+        seq = cacheSeq;
+        RTC_BARRIER();
+        snap = cache[seq & 1];
+        RTC_BARRIER();
+    } while (seq != cacheSeq);
+    return snap.unixtime != 0;
+}
+
+/**
+ * @brief The cached time advanced by millis() since it was read; ISR safe
+ * @return Seconds since 1/1/1970, or 0 if refresh() has not succeeded yet
+ */
+uint32_t RTC_DS3231::cachedUnixtime(void) {
+    Ds3231Snapshot snap;
+    if (!snapshot(snap))
+        return 0;
+    return snap.unixtime + (millis() - snap.millis) / 1000;
+}
+
+/**
+ * @brief The temperature from the last refresh(); ISR safe
+ */
+float RTC_DS3231::cachedTemp(void) {
+    Ds3231Snapshot snap;
+    snapshot(snap);
+    return snap.tempQuarter * 0.25;
+}
+
+/**
+ * @brief Number of calls refused because the bus was in use
+ */
+uint16_t RTC_DS3231::busRejections(void) {
+    return rtc_bus_rejections;
+}
+
 /**
  * @brief Access the DS3231 Control register
  *
@@ -543,6 +1116,8 @@ DateTime RTC_DS3231::now() {
  * @return The Ds3231SqwPinMode
  */
 Ds3231SqwPinMode RTC_DS3231::readSqwPinMode() {
+    RTC_PROBE(DS3231_READSQWPINMODE);
+    RTC_BUS_GUARD(DS3231_OFF);
     int mode;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -577,6 +1152,8 @@ Ds3231SqwPinMode RTC_DS3231::readSqwPinMode() {
  * @param mode One of Ds3231SqwPinMode
  */
 void RTC_DS3231::writeSqwPinMode(Ds3231SqwPinMode mode) {
+    RTC_PROBE(DS3231_WRITESQWPINMODE);
+    RTC_BUS_GUARD();
     uint8_t ctrl;
     ctrl = read_i2c_register(DS3231_ADDRESS, DS3231_CONTROL);
 
@@ -596,6 +1173,8 @@ void RTC_DS3231::writeSqwPinMode(Ds3231SqwPinMode mode) {
 /*----------------------------------------------------------------------*/
 
 float RTC_DS3231::getTemp() {
+    RTC_PROBE(DS3231_GETTEMP);
+    RTC_BUS_GUARD(cachedTemp());
     int8_t temp_msb, temp_lsb;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -616,6 +1195,42 @@ float RTC_DS3231::getTemp() {
     }
 }
 
+/**
+ * @brief Pipelined temperature sampling
+ *
+ * Reads the result of the previous conversion and starts the next one, so
+ * successive calls (e.g. once a minute from loop()) never busy-wait the way
+ * forceConversion() does. One 5 byte burst read of control, status, aging
+ * and temperature, then one control write.
+ *
+ * @param stats Receives the sample
+ * @return False, without adding a sample, if a conversion is still running
+ * or another method holds the bus
+ */
+bool RTC_DS3231::sampleTemp(Ds3231TempStats &stats) {
+    RTC_PROBE(DS3231_SAMPLETEMP);
+    RTC_BUS_GUARD(false);
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire._I2C_WRITE((byte) DS3231_CONTROL);
+    Wire.endTransmission();
+
+    if (Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 5) != 5)
+        return false;
+    uint8_t control = Wire._I2C_READ();
+    uint8_t status = Wire._I2C_READ();
+    Wire._I2C_READ(); // aging offset
+    int8_t msb = Wire._I2C_READ();
+    uint8_t lsb = Wire._I2C_READ();
+
+    if ((control & 0b00100000) || (status & 0b00000100)) // CONV or BSY
+        return false;
+
+    stats.add(msb * 4 + (lsb >> 6));
+    write_i2c_register(DS3231_ADDRESS, DS3231_CONTROL, control | 0b00100000);
+    return true;
+}
+
 /**
  * @brief Test the status of the EN32kHz bit of the control/status register
  *
@@ -626,10 +1241,9 @@ float RTC_DS3231::getTemp() {
  * @return True if pin 1 is set to output a 32kHz square wave, false if not
  */
 bool RTC_DS3231::getEN32kHz(void) {
-    //void write(byte addr, byte value);
-    //byte read(byte addr);
-
-    byte _byteValue = read(DS3231_STATUSREG);
+    RTC_PROBE(DS3231_GETEN32KHZ);
+    RTC_BUS_GUARD(false);
+    byte _byteValue = read_i2c_register(DS3231_ADDRESS, DS3231_STATUSREG);
 
     if (_byteValue & DS3231_EN32kHz) {
         return (true);
@@ -651,7 +1265,9 @@ bool RTC_DS3231::getEN32kHz(void) {
  * reduces battery-backed power use.
  */
 byte RTC_DS3231::setEN32kHz(bool Enable) {
-    byte _byteValue = read(DS3231_STATUSREG);
+    RTC_PROBE(DS3231_SETEN32KHZ);
+    RTC_BUS_GUARD(0);
+    byte _byteValue = read_i2c_register(DS3231_ADDRESS, DS3231_STATUSREG);
 
     if (Enable == true) {
         // Set the bit to enable 32kHz output on pin 1
@@ -660,8 +1276,8 @@ byte RTC_DS3231::setEN32kHz(bool Enable) {
         // Clear the bit to enable 32kHz output on pin 1
         _byteValue &= ~DS3231_EN32kHz;
     }
-    
-    write(DS3231_STATUSREG, _byteValue);
+
+    write_i2c_register(DS3231_ADDRESS, DS3231_STATUSREG, _byteValue);
     return _byteValue;
 }
 
@@ -675,10 +1291,9 @@ byte RTC_DS3231::setEN32kHz(bool Enable) {
  * @return True if BBSQW is set, false if not
  */
 bool RTC_DS3231::getBBSQW(void) {
-    //void write(byte addr, byte value);
-    //byte read(byte addr);
-
-    byte _byteValue = read(DS3231_CONTROL);
+    RTC_PROBE(DS3231_GETBBSQW);
+    RTC_BUS_GUARD(false);
+    byte _byteValue = read_i2c_register(DS3231_ADDRESS, DS3231_CONTROL);
 
     if (_byteValue & DS3231_BBSQW) {
         return (true);
@@ -698,7 +1313,9 @@ bool RTC_DS3231::getBBSQW(void) {
  * more power when battery backed.
  */
 byte RTC_DS3231::setBBSQW(bool Enable) {
-    byte _byteValue = read(DS3231_CONTROL);
+    RTC_PROBE(DS3231_SETBBSQW);
+    RTC_BUS_GUARD(0);
+    byte _byteValue = read_i2c_register(DS3231_ADDRESS, DS3231_CONTROL);
 
     if (Enable == true) {
         // Set the bit to enable 32kHz output on pin 1
@@ -708,15 +1325,63 @@ byte RTC_DS3231::setBBSQW(bool Enable) {
         _byteValue &= ~DS3231_BBSQW;
     }
 
-    write(DS3231_STATUSREG, _byteValue);
+    write_i2c_register(DS3231_ADDRESS, DS3231_CONTROL, _byteValue);
     return _byteValue;
 }
 
+// Bodies of armAlarm() and clearAlarm() without the bus guard, so that
+// setAlarm() can use them while it holds the bus
+static void ds3231_arm_alarm(byte alarmNumber, bool armed) {
+    uint8_t value, mask;
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_CONTROL);
+    Wire.endTransmission();
+
+    Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 1);
+    value = Wire._I2C_READ();
+    Wire.endTransmission();
+
+    mask = _BV(alarmNumber - 1);
+    if (armed) {
+        value |= mask;
+    } else {
+        value &= ~mask;
+    }
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_CONTROL);
+    Wire.write(value);
+    Wire.endTransmission();
+}
+
+static void ds3231_clear_alarm(byte alarmNumber) {
+    uint8_t value, mask;
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_STATUSREG);
+    Wire.endTransmission();
+
+    Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 1);
+    value = Wire._I2C_READ();
+    Wire.endTransmission();
+
+    mask = _BV(alarmNumber - 1);
+    value &= ~mask;
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_STATUSREG);
+    Wire.write(value);
+    Wire.endTransmission();
+}
+
 /*----------------------------------------------------------------------*
  * Enable or disable an alarm "interrupt" which asserts the INT pin     *
  * on the RTC.                                                          *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::alarmInterrupt(byte alarmNumber, bool interruptEnabled) {
+    RTC_PROBE(DS3231_ALARMINTERRUPT);
+    RTC_BUS_GUARD();
     uint8_t controlReg, mask;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -749,6 +1414,8 @@ void RTC_DS3231::alarmInterrupt(byte alarmNumber, bool interruptEnabled) {
  * ignored, recommend using zero. (Alarm 2 has no seconds register.)    *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate) {
+    RTC_PROBE(DS3231_SETALARM);
+    RTC_BUS_GUARD();
 
     uint8_t addr;
     byte alarmNumber;
@@ -790,8 +1457,8 @@ void RTC_DS3231::setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte min
     Wire.write(daydate);
     Wire.endTransmission();
 
-    armAlarm(alarmNumber, true);
-    clearAlarm(alarmNumber);
+    ds3231_arm_alarm(alarmNumber, true);
+    ds3231_clear_alarm(alarmNumber);
 }
 
 /*----------------------------------------------------------------------*
@@ -811,27 +1478,9 @@ void RTC_DS3231::setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte minutes, byte hou
  * value of alarmNumber (1 or 2) and arm (true or false).               *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::armAlarm(byte alarmNumber, bool armed) {
-    uint8_t value, mask;
-
-    Wire.beginTransmission(DS3231_ADDRESS);
-    Wire.write(DS3231_CONTROL);
-    Wire.endTransmission();
-
-    Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 1);
-    value = Wire._I2C_READ();
-    Wire.endTransmission();
-
-    mask = _BV(alarmNumber - 1);
-    if (armed) {
-        value |= mask;
-    } else {
-        value &= ~mask;
-    }
-
-    Wire.beginTransmission(DS3231_ADDRESS);
-    Wire.write(DS3231_CONTROL);
-    Wire.write(value);
-    Wire.endTransmission();
+    RTC_PROBE(DS3231_ARMALARM);
+    RTC_BUS_GUARD();
+    ds3231_arm_alarm(alarmNumber, armed);
 }
 
 /*----------------------------------------------------------------------*
@@ -839,23 +1488,9 @@ void RTC_DS3231::armAlarm(byte alarmNumber, bool armed) {
  * depending on the value of alarmNumber (1 or 2).                      *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::clearAlarm(byte alarmNumber) {
-    uint8_t value, mask;
-
-    Wire.beginTransmission(DS3231_ADDRESS);
-    Wire.write(DS3231_STATUSREG);
-    Wire.endTransmission();
-
-    Wire.requestFrom((uint8_t) DS3231_ADDRESS, (uint8_t) 1);
-    value = Wire._I2C_READ();
-    Wire.endTransmission();
-
-    mask = _BV(alarmNumber - 1);
-    value &= ~mask;
-
-    Wire.beginTransmission(DS3231_ADDRESS);
-    Wire.write(DS3231_STATUSREG);
-    Wire.write(value);
-    Wire.endTransmission();
+    RTC_PROBE(DS3231_CLEARALARM);
+    RTC_BUS_GUARD();
+    ds3231_clear_alarm(alarmNumber);
 }
 
 /*----------------------------------------------------------------------*
@@ -863,6 +1498,8 @@ void RTC_DS3231::clearAlarm(byte alarmNumber) {
  * value of alarmNumber (1 or 2).                                       *
  *----------------------------------------------------------------------*/
 bool RTC_DS3231::isArmed(byte alarmNumber) {
+    RTC_PROBE(DS3231_ISARMED);
+    RTC_BUS_GUARD(false);
     uint8_t value;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -887,6 +1524,8 @@ bool RTC_DS3231::isArmed(byte alarmNumber) {
  * Valid address range is 0x00 - 0x12, no checking.                     *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::write(byte addr, byte value) {
+    RTC_PROBE(DS3231_WRITE);
+    RTC_BUS_GUARD();
 
     Wire.beginTransmission(DS3231_ADDRESS);
     Wire.write(addr);
@@ -899,6 +1538,8 @@ void RTC_DS3231::write(byte addr, byte value) {
  * Valid address range is 0x00 - 0x12, no checking.                     *
  *----------------------------------------------------------------------*/
 byte RTC_DS3231::read(byte addr) {
+    RTC_PROBE(DS3231_READ);
+    RTC_BUS_GUARD(0);
     uint8_t value;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -912,12 +1553,44 @@ byte RTC_DS3231::read(byte addr) {
     return value;
 }
 
+/**
+ * @brief Read the DS3231 aging offset register
+ *
+ * The aging offset is a two's complement value added to the capacitance
+ * array of the crystal oscillator. Each LSB is roughly 0.1 ppm at 25C;
+ * positive values add capacitance and slow the oscillator down.
+ *
+ * @return The signed aging offset
+ */
+int8_t RTC_DS3231::getAgingOffset(void) {
+    RTC_PROBE(DS3231_GETAGINGOFFSET);
+    RTC_BUS_GUARD(0);
+    return (int8_t) read_i2c_register(DS3231_ADDRESS, DS3231_AGING_OFFSET);
+}
+
+/**
+ * @brief Write the DS3231 aging offset register
+ *
+ * @param offset The signed aging offset, -128..127
+ *
+ * @note The new value only affects the oscillator after the next temperature
+ * conversion; call forceConversion() to apply it immediately.
+ * @see getAgingOffset
+ */
+void RTC_DS3231::setAgingOffset(int8_t offset) {
+    RTC_PROBE(DS3231_SETAGINGOFFSET);
+    RTC_BUS_GUARD();
+    write_i2c_register(DS3231_ADDRESS, DS3231_AGING_OFFSET, (uint8_t) offset);
+}
+
 /*----------------------------------------------------------------------*
  * The temperature registers are updated after every 64-second          *
  * conversion. If you want force temperature conversion call this       *
  * function.                                                            *
  *----------------------------------------------------------------------*/
 void RTC_DS3231::forceConversion(void) {
+    RTC_PROBE(DS3231_FORCECONVERSION);
+    RTC_BUS_GUARD();
     uint8_t value;
 
     Wire.beginTransmission(DS3231_ADDRESS);
@@ -10,7 +10,14 @@ class TimeSpan;
 
 #define PCF8523_ADDRESS              0x68
 #define PCF8523_CLKOUTCONTROL        0x0F
+#define PCF8523_CONTROL_1            0x00
+#define PCF8523_CONTROL_2            0x01
 #define PCF8523_CONTROL_3            0x02
+#define PCF8523_OFFSET               0x0E
+#define PCF8523_TIMER_A_FRCTL        0x10
+#define PCF8523_TIMER_A_VALUE        0x11
+#define PCF8523_TIMER_B_FRCTL        0x12
+#define PCF8523_TIMER_B_VALUE        0x13
 
 #define DS1307_ADDRESS               0x68
 #define DS1307_CONTROL               0x07
@@ -19,11 +26,22 @@ class TimeSpan;
 #define DS3231_ADDRESS               0x68
 #define DS3231_CONTROL               0x0E
 #define DS3231_STATUSREG             0x0F
+#define DS3231_AGING_OFFSET          0x10
 #define DS3231_TEMP                  0x11
 
+// Time from endTransmission() until the DS3231 latches the seconds register
+// (start, address, register pointer and seconds byte at 100kHz), microseconds
+#define DS3231_ALIGN_LATENCY_US      300
+// Give up waiting for a PPS edge after this many milliseconds
+#define DS3231_PPS_TIMEOUT_MS        2000
+
 #define SECONDS_PER_DAY              86400L
 
 #define SECONDS_FROM_1970_TO_2000    946684800
+// What RTC_DS3231::now() returns from an ISR, or while the bus is busy,
+// before refresh() has filled the cache: 1/1/2000 00:00:00, which is also
+// what a DS3231 reads after losing power
+#define DS3231_CACHE_EMPTY           SECONDS_FROM_1970_TO_2000
 
 // Battery Backup Square Wave interrupt status bit. Controls
 // if the clock will issue and interrupt on alarm when running
@@ -79,7 +97,7 @@ public:
     uint8_t second() const      { return ss; }
     uint8_t dayOfTheWeek() const;
 
-    // 32-bit times as seconds since 1/1/2000
+    // 32-bit times as seconds since 1/1/2000 (negative after 2068 where long is 32 bits)
     long secondstime() const;   
     // 32-bit times as seconds since 1/1/1970
     uint32_t unixtime(void) const;
@@ -111,6 +129,22 @@ protected:
     int32_t _seconds;
 };
 
+// All the fields of a TimeSpan computed in one pass with multiplications
+// instead of the four 32-bit divisions of the TimeSpan accessors; use it
+// when formatting a span. Negative spans give negative fields, as TimeSpan does.
+class TimeSpanFields {
+public:
+    TimeSpanFields (const TimeSpan& span);
+    int16_t days() const         { return _days; }
+    int8_t  hours() const        { return _hours; }
+    int8_t  minutes() const      { return _minutes; }
+    int8_t  seconds() const      { return _seconds; }
+
+protected:
+    int16_t _days;
+    int8_t _hours, _minutes, _seconds;
+};
+
 // RTC based on the DS1307 chip connected via I2C and the Wire library
 enum Ds1307SqwPinMode { OFF = 0x00, ON = 0x80, SquareWave1HZ = 0x10, SquareWave4kHz = 0x11, SquareWave8kHz = 0x12, SquareWave32kHz = 0x13 };
 
@@ -147,15 +181,59 @@ enum Ds3231_ALARM_TYPES_t {
     ALM2_MATCH_DAY = 0x90,         //match day *and* hours, minutes
 };
 
+// Running temperature statistics in quarter degrees C, fixed point only.
+// Mean and variance use Welford's update; min/max are kept for all samples
+// and for a tumbling window of `window` samples: windowMin()/windowMax()
+// cover the last complete window plus the one being filled.
+class Ds3231TempStats {
+public:
+    Ds3231TempStats(uint16_t window = 60);
+    void reset();
+    void add(int16_t tempQuarter);
+
+    uint32_t count() const          { return _n; }
+    int16_t meanQuarter() const     { return (_mean + (_mean >= 0 ? 32768L : -32768L)) / 65536L; }
+    float mean() const              { return _mean / 262144.0; }
+    float variance() const;         // degrees C squared
+    int16_t minQuarter() const      { return _min; }
+    int16_t maxQuarter() const      { return _max; }
+    int16_t windowMin() const       { return _prevMin < _winMin ? _prevMin : _winMin; }
+    int16_t windowMax() const       { return _prevMax > _winMax ? _prevMax : _winMax; }
+
+protected:
+    uint32_t _n;
+    int32_t _mean;          // quarter degrees, Q16
+    int64_t _m2;            // sum of squared deviations, quarter degrees squared, Q32
+    int16_t _min, _max;
+    uint16_t _window, _winCount;
+    int16_t _winMin, _winMax, _prevMin, _prevMax;
+};
+
+// DS3231 state published by RTC_DS3231::refresh()
+struct Ds3231Snapshot {
+    uint32_t unixtime;      // seconds since 1/1/1970 when it was read
+    uint32_t millis;        // millis() when it was read
+    uint8_t control;
+    uint8_t status;
+    int16_t tempQuarter;    // quarter degrees C
+};
+
 class RTC_DS3231 {
 public:
     boolean begin(void);
     static void adjust(const DateTime& dt);
+    // Set the time so the seconds tick lines up with a reference clock
+    static bool adjustAligned(const DateTime& dt, uint16_t fracMs, uint32_t refMillis,
+                              uint16_t latencyUs = DS3231_ALIGN_LATENCY_US);
+    static bool adjustAligned(const DateTime& dt, bool (*ppsEdge)(void),
+                              uint16_t latencyUs = DS3231_ALIGN_LATENCY_US);
     bool lostPower(void);
     static DateTime now();
     static Ds3231SqwPinMode readSqwPinMode();
     static void writeSqwPinMode(Ds3231SqwPinMode mode);
     float getTemp();
+    // Feed stats without waiting for a conversion, see the .cpp
+    bool sampleTemp(Ds3231TempStats& stats);
 
     // Added jhrg 1/22/20
     bool getEN32kHz(void);
@@ -164,6 +242,11 @@ public:
     byte setBBSQW(bool Enable);
 
     void forceConversion(void);
+
+    // Crystal aging trim, roughly 0.1 ppm per LSB; positive values slow the clock
+    int8_t getAgingOffset(void);
+    void setAgingOffset(int8_t offset);
+
     void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte seconds, byte minutes, byte hours, byte daydate);
     void setAlarm(Ds3231_ALARM_TYPES_t alarmType, byte minutes, byte hours, byte daydate);
     void armAlarm(byte alarmNumber, bool armed);
@@ -172,11 +255,36 @@ public:
     void clearAlarm(byte alarmNumber);
     void write(byte addr, byte value);
     byte read(byte addr);
+
+    // Interrupt-safe access. All methods above refuse to touch the bus when
+    // called from an interrupt handler or while another one holds it; now()
+    // then returns the cached time (DS3231_CACHE_EMPTY until the first
+    // refresh()) and getTemp() cachedTemp(). refresh() reads the chip from
+    // the main context; the cached*() methods and snapshot() only read RAM
+    // and may be called from an ISR.
+    static bool refresh(void);
+    static bool snapshot(Ds3231Snapshot& snap);
+    static uint32_t cachedUnixtime(void);
+    static float cachedTemp(void);
+    static uint16_t busRejections(void);
+
+protected:
+    static volatile uint8_t cacheSeq;
+    static Ds3231Snapshot cache[2];
 };
 
 // RTC based on the PCF8523 chip connected via I2C and the Wire library
 enum Pcf8523SqwPinMode { PCF8523_OFF = 7, PCF8523_SquareWave1HZ = 6, PCF8523_SquareWave32HZ = 5, PCF8523_SquareWave1kHz = 4, PCF8523_SquareWave4kHz = 3, PCF8523_SquareWave8kHz = 2, PCF8523_SquareWave16kHz = 1, PCF8523_SquareWave32kHz = 0 };
 
+// Countdown timers A and B; each counts numPeriods ticks of its source clock
+// and then interrupts on INT1 (CLKOUT must be off), reloading by itself
+enum Pcf8523Timer { PCF8523_TimerA = 0, PCF8523_TimerB = 1 };
+enum Pcf8523TimerClockFreq { PCF8523_Frequency4kHz = 0, PCF8523_Frequency64Hz = 1, PCF8523_FrequencySecond = 2, PCF8523_FrequencyMinute = 3, PCF8523_FrequencyHour = 4 };
+// Width of the timer B interrupt pulse (timer A pulses last one tick of 64Hz)
+enum Pcf8523TimerIntPulse { PCF8523_LowPulse3x64Hz = 0, PCF8523_LowPulse4x64Hz = 1, PCF8523_LowPulse5x64Hz = 2, PCF8523_LowPulse6x64Hz = 3, PCF8523_LowPulse8x64Hz = 4, PCF8523_LowPulse10x64Hz = 5, PCF8523_LowPulse12x64Hz = 6, PCF8523_LowPulse14x64Hz = 7 };
+// How often the offset correction is applied: 4.34 ppm or 4.069 ppm per step
+enum Pcf8523OffsetMode { PCF8523_TwoHours = 0x00, PCF8523_OneMinute = 0x80 };
+
 class RTC_PCF8523 {
 public:
     boolean begin(void);
@@ -186,6 +294,16 @@ public:
 
     Pcf8523SqwPinMode readSqwPinMode();
     void writeSqwPinMode(Pcf8523SqwPinMode mode);
+
+    void enableCountdownTimer(Pcf8523Timer timer, Pcf8523TimerClockFreq clkFreq, uint8_t numPeriods,
+                              bool pulse = true, Pcf8523TimerIntPulse pulseWidth = PCF8523_LowPulse8x64Hz);
+    void disableCountdownTimer(Pcf8523Timer timer);
+    bool countdownFired(Pcf8523Timer timer);
+    void clearCountdownFlag(Pcf8523Timer timer);
+
+    void writeOffset(Pcf8523OffsetMode mode, int8_t offset);
+    int8_t readOffset(Pcf8523OffsetMode& mode);
+    int8_t calibrate(Pcf8523OffsetMode mode, float driftPpm);
 };
 
 // RTC using the internal millis() clock, has to be initialized before use
@@ -0,0 +1,69 @@
+// Just enough of the Arduino core to build the library on a Linux host
+// Released to the public domain! Enjoy!
+//
+// Time is simulated: millis() and micros() read a 64-bit microsecond clock
+// that only moves on delay(), host_advance_us() and by one microsecond per
+// micros() or millis() call, so polling loops end and runs are repeatable.
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ARDUINO 10813
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define PSTR(s) (s)
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr) (*(const void * const *)(addr))
+#define memcpy_P memcpy
+#define _BV(bit) (1UL << (bit))
+
+extern uint64_t host_us;
+// Set by a test to run library code as if from an interrupt handler
+extern bool host_in_isr;
+#define RTC_IN_ISR() host_in_isr
+
+inline void host_advance_us(uint64_t us)    { host_us += us; }
+inline uint32_t micros()                    { return (uint32_t) ++host_us; }
+inline uint32_t millis()                    { return (uint32_t) (++host_us / 1000); }
+inline void delay(uint32_t ms)              { host_us += ms * 1000ULL; }
+inline void delayMicroseconds(uint32_t us)  { host_us += us; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline void yield() {}
+
+// Writes to stdout, or to a FILE given to the constructor
+class Print {
+public:
+    Print(FILE *out = stdout) : _out(out) {}
+
+    size_t print(const char *s)                     { return fprintf(_out, "%s", s); }
+    size_t print(const __FlashStringHelper *s)      { return print((const char *) s); }
+    size_t print(char c)                            { return fprintf(_out, "%c", c); }
+    size_t print(int v)                             { return fprintf(_out, "%d", v); }
+    size_t print(unsigned v)                        { return fprintf(_out, "%u", v); }
+    size_t print(long v)                            { return fprintf(_out, "%ld", v); }
+    size_t print(unsigned long v)                   { return fprintf(_out, "%lu", v); }
+    size_t print(double v, int digits = 2)          { return fprintf(_out, "%.*f", digits, v); }
+    size_t println()                                { return print('\n'); }
+    template <class T> size_t println(T v)          { return print(v) + println(); }
+    size_t println(double v, int digits)            { return print(v, digits) + println(); }
+
+protected:
+    FILE *_out;
+};
+
+extern Print Serial;
+
+#endif // _HOST_ARDUINO_H_
@@ -0,0 +1,81 @@
+// A TwoWire for host builds that talks to simulated I2C devices
+// Released to the public domain! Enjoy!
+//
+// Devices are attached at an address, either on the main bus or behind a
+// channel of a HostTCA9548A. Writes reach every device that is selected at
+// the address; reads from several of them are wired-AND, as on open-drain
+// lines. An address with no device NACKs.
+
+#ifndef _HOST_WIRE_H_
+#define _HOST_WIRE_H_
+
+#include "Arduino.h"
+
+#define HOST_WIRE_BUFFER    32
+#define HOST_WIRE_DEVICES   16
+
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {}
+    virtual void start(bool read)       { (void) read; }
+    virtual void receive(uint8_t data) = 0;
+    virtual uint8_t transmit() = 0;
+    virtual void stop() {}
+};
+
+// The mux itself: one control byte, bit n connects channel n
+class HostTCA9548A : public HostI2CDevice {
+public:
+    HostTCA9548A() : channels(0) {}
+    void receive(uint8_t data)          { channels = data; }
+    uint8_t transmit()                  { return channels; }
+
+    uint8_t channels;
+};
+
+class TwoWire {
+public:
+    TwoWire();
+
+    void attach(uint8_t address, HostI2CDevice *device);
+    void attach(uint8_t address, HostI2CDevice *device, HostTCA9548A *mux, uint8_t channel);
+    void detachAll()                    { _devices = 0; }
+
+    void begin() {}
+    void setClock(uint32_t) {}
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t) address); }
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t len);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = 1);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t) address, (uint8_t) quantity); }
+    int available()                     { return _rxLen - _rxPos; }
+    int read()                          { return _rxPos < _rxLen ? _rx[_rxPos++] : -1; }
+
+    // Start conditions and bytes, address bytes included, since power-up
+    uint32_t transactions;
+    uint32_t bytes;
+
+protected:
+    struct Slot {
+        uint8_t address;
+        HostI2CDevice *device;
+        HostTCA9548A *mux;
+        uint8_t channel;
+    };
+
+    uint8_t select(uint8_t address, HostI2CDevice **found);
+
+    Slot _slot[HOST_WIRE_DEVICES];
+    uint8_t _devices;
+    uint8_t _txAddress;
+    uint8_t _tx[HOST_WIRE_BUFFER];
+    uint8_t _txLen;
+    uint8_t _rx[HOST_WIRE_BUFFER];
+    uint8_t _rxLen, _rxPos;
+};
+
+extern TwoWire Wire;
+
+#endif // _HOST_WIRE_H_
@@ -0,0 +1,84 @@
+// Nanoseconds per call of the DateTime and TimeSpan conversions
+// Released to the public domain! Enjoy!
+//
+// Usage: bench_datetime [thresholds]. Every line of the thresholds file is a
+// benchmark name and the most ns/op it may take; the exit code is 1 if one
+// is slower. The limits are loose enough for a slow CI machine and catch an
+// accidental loop or a division creeping back in, not a few percent.
+
+#include <stdlib.h>
+#include <string.h>
+#include "RTClibExtended.h"
+#include "host_test.h"
+
+#define BENCH_OPS 2000000UL
+
+static volatile uint32_t sink;
+
+struct Bench {
+    const char *name;
+    uint32_t (*run)(uint32_t i);
+};
+
+static uint32_t from_unixtime(uint32_t i) {
+    return DateTime(SECONDS_FROM_1970_TO_2000 + i * 1543).day();
+}
+
+static uint32_t to_unixtime(uint32_t i) {
+    return DateTime(2000 + i % 100, 1 + i % 12, 1 + i % 28, i % 24, i % 60, i % 60).unixtime();
+}
+
+static uint32_t day_of_week(uint32_t i) {
+    return DateTime(2000 + i % 100, 1 + i % 12, 1 + i % 28).dayOfTheWeek();
+}
+
+static uint32_t timespan_accessors(uint32_t i) {
+    TimeSpan s((int32_t) (i * 2654435761UL));
+    return s.days() + s.hours() + s.minutes() + s.seconds();
+}
+
+static uint32_t timespan_fields(uint32_t i) {
+    TimeSpanFields f(TimeSpan((int32_t) (i * 2654435761UL)));
+    return f.days() + f.hours() + f.minutes() + f.seconds();
+}
+
+static uint32_t add_timespan(uint32_t i) {
+    return (DateTime(SECONDS_FROM_1970_TO_2000 + i * 1543) + TimeSpan(i)).unixtime();
+}
+
+static uint32_t compile_time(uint32_t i) {
+    static const char *const dates[] = { "Jan  5 2021", "Jun 30 2045", "Dec 26 2009", "Aug 15 2077" };
+    return DateTime(dates[i & 3], "12:34:56").unixtime();
+}
+
+static const Bench benches[] = {
+    { "DateTime(uint32_t)", from_unixtime },
+    { "DateTime::unixtime", to_unixtime },
+    { "DateTime::dayOfTheWeek", day_of_week },
+    { "TimeSpan_accessors", timespan_accessors },
+    { "TimeSpanFields", timespan_fields },
+    { "DateTime+TimeSpan", add_timespan },
+    { "DateTime(date,time)", compile_time },
+};
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : 0;
+    int slow = 0;
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+        uint32_t acc = 0;
+        double t0 = host_wall_ns();
+        for (uint32_t i = 0; i < BENCH_OPS; ++i)
+            acc += benches[b].run(i);
+        double ns = (host_wall_ns() - t0) / BENCH_OPS;
+        sink = acc;
+
+        double limit = host_bench_limit(path, benches[b].name);
+        bool over = limit > 0 && ns > limit;
+        printf("%-24s %8.2f ns/op", benches[b].name, ns);
+        if (limit > 0)
+            printf("  (limit %.0f)%s", limit, over ? "  SLOW" : "");
+        printf("\n");
+        slow |= over;
+    }
+    return slow;
+}
@@ -0,0 +1,91 @@
+// Decoder and encoder throughput of the compact timestamp stream
+// Released to the public domain! Enjoy!
+//
+// Usage: bench_timestamp_stream [thresholds]. Reports ns per stream byte
+// and MB/s for a million records a few seconds apart, with and without
+// temperatures; the limits in the thresholds file are ns per byte, as for
+// bench_datetime.
+
+#include <stdlib.h>
+#include <vector>
+#include "RTCTimestampStream.h"
+#include "host_test.h"
+
+#define BENCH_RECORDS 1000000UL
+#define BENCH_ROUNDS 20
+
+static volatile uint32_t sink;
+
+static size_t build(std::vector<uint8_t> &buf, bool temps) {
+    buf.resize(BENCH_RECORDS * 3 + 1024);
+    RTC_TimestampEncoder enc(buf.data(), buf.size(), 32, temps);
+    uint32_t t = 1800000000UL;
+    int16_t temp = 100;
+    srand(1);
+    for (uint32_t i = 0; i < BENCH_RECORDS; ++i) {
+        t += 1 + rand() % 10;
+        temp += rand() % 3 - 1;
+        enc.append(t, temp);
+    }
+    buf.resize(enc.length());
+    return enc.length();
+}
+
+static bool report(const char *path, const char *name, double ns, size_t bytes) {
+    double perByte = ns / bytes;
+    double limit = host_bench_limit(path, name);
+    bool over = limit > 0 && perByte > limit;
+    printf("%-24s %8.3f ns/byte %8.0f MB/s %6.2f ns/record", name, perByte, 1e3 / perByte, ns / BENCH_RECORDS);
+    if (limit > 0)
+        printf("  (limit %.1f)%s", limit, over ? "  SLOW" : "");
+    printf("\n");
+    return over;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : 0;
+    int slow = 0;
+    for (int temps = 0; temps < 2; ++temps) {
+        std::vector<uint8_t> buf;
+        size_t bytes = build(buf, temps);
+
+        double best = 1e18;
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            RTC_TimestampDecoder dec(buf.data(), buf.size());
+            uint32_t t, acc = 0;
+            int16_t temp;
+            double t0 = host_wall_ns();
+            while (dec.next(t, temp))
+                acc += t + temp;
+            double ns = host_wall_ns() - t0;
+            sink = acc;
+            if (ns < best)
+                best = ns;
+        }
+        slow |= report(path, temps ? "TimestampDecoder_temps" : "TimestampDecoder", best, bytes);
+
+        std::vector<uint32_t> times;
+        std::vector<int16_t> quarters;
+        RTC_TimestampDecoder dec(buf.data(), buf.size());
+        uint32_t t;
+        int16_t temp;
+        while (dec.next(t, temp)) {
+            times.push_back(t);
+            quarters.push_back(temp);
+        }
+        std::vector<uint8_t> out(buf.size());
+        best = 1e18;
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            RTC_TimestampEncoder enc(out.data(), out.size(), 32, temps);
+            double t0 = host_wall_ns();
+            for (size_t i = 0; i < times.size(); ++i)
+                enc.append(times[i], quarters[i]);
+            double ns = host_wall_ns() - t0;
+            sink = enc.length();
+            if (ns < best)
+                best = ns;
+        }
+        slow |= report(path, temps ? "TimestampEncoder_temps" : "TimestampEncoder", best, bytes);
+    }
+    return slow;
+}
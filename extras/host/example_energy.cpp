@@ -0,0 +1,50 @@
+// Battery life of two DS3231 logger configurations, on the host
+// Released to the public domain! Enjoy!
+//
+// A logger on a CR2032 wakes every minute on alarm 2, reads the time and
+// the temperature and clears the alarm. The first configuration keeps the
+// DS3231 on Vcc, leaves the 32kHz output on (into a 10k pull-up) and forces
+// a temperature conversion before each reading. The second runs the chip
+// from Vbat between accesses, with BBSQW set so the alarm still reaches
+// the MCU, turns the output off and uses the automatic conversion of the
+// last 64 seconds. A simulated year of each runs through
+// RTC_EnergyModel::report().
+//
+//   make examples
+
+#include "RTCEnergyModel.h"
+
+static bool forceConversion;
+
+static void onAlarm(RTC_DS3231_Sim &rtc, byte alarmNumber) {
+    rtc.now();
+    if (forceConversion)
+        rtc.forceConversion();
+    rtc.getTemp();
+    rtc.clearAlarm(alarmNumber);
+}
+
+static void run(const char *name, bool onBattery, bool en32kHz, bool force) {
+    RtcBoardProfile board;
+    board.clkPullupOhms = 10000;
+    board.wakeUc = 30;
+    board.rtcOnBattery = onBattery;
+    RTC_EnergyModel model(RTC_POWER_DS3231, board);
+    RTC_DS3231_Sim rtc(model);
+
+    rtc.setEN32kHz(en32kHz);
+    rtc.setBBSQW(onBattery);
+    rtc.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+    forceConversion = force;
+    rtc.run(365 * 86400L, onAlarm);
+
+    Serial.println(name);
+    model.report(Serial, 220);
+    Serial.println();
+}
+
+int main() {
+    run("On Vcc, 32kHz on, forced conversions", false, true, true);
+    run("On Vbat with BBSQW, 32kHz off, automatic conversions", true, false, false);
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Globals of the host shim and the simulated bus
+// Released to the public domain! Enjoy!
+
+#include "Wire.h"
+#include "host_test.h"
+
+uint64_t host_us = 0;
+bool host_in_isr = false;
+Print Serial;
+TwoWire Wire;
+
+////////////////////////////////////////////////////////////////////////////////
+// TwoWire implementation
+
+TwoWire::TwoWire() : transactions(0), bytes(0), _devices(0), _txAddress(0), _txLen(0), _rxLen(0), _rxPos(0) {}
+
+void TwoWire::attach(uint8_t address, HostI2CDevice *device) {
+    attach(address, device, 0, 0);
+}
+
+void TwoWire::attach(uint8_t address, HostI2CDevice *device, HostTCA9548A *mux, uint8_t channel) {
+    if (_devices == HOST_WIRE_DEVICES)
+        return;
+    Slot &s = _slot[_devices++];
+    s.address = address;
+    s.device = device;
+    s.mux = mux;
+    s.channel = channel;
+}
+
+// Collects the devices selected at an address, returns how many
+uint8_t TwoWire::select(uint8_t address, HostI2CDevice **found) {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _devices; ++i) {
+        const Slot &s = _slot[i];
+        if (s.address == address && (!s.mux || (s.mux->channels & _BV(s.channel))))
+            found[n++] = s.device;
+    }
+    return n;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    _txAddress = address;
+    _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (_txLen == HOST_WIRE_BUFFER)
+        return 0;
+    _tx[_txLen++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (n < len && write(data[n]))
+        ++n;
+    return n;
+}
+
+// 0 on success, 2 if the address was not acknowledged
+uint8_t TwoWire::endTransmission(bool) {
+    HostI2CDevice *found[HOST_WIRE_DEVICES];
+    uint8_t n = select(_txAddress, found);
+    ++transactions;
+    bytes += 1 + (n ? _txLen : 0);
+    for (uint8_t i = 0; i < n; ++i) {
+        found[i]->start(false);
+        for (uint8_t j = 0; j < _txLen; ++j)
+            found[i]->receive(_tx[j]);
+        found[i]->stop();
+    }
+    return n ? 0 : 2;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t) {
+    HostI2CDevice *found[HOST_WIRE_DEVICES];
+    uint8_t n = select(address, found);
+    ++transactions;
+    ++bytes;
+    _rxLen = _rxPos = 0;
+    if (!n)
+        return 0;
+    if (quantity > HOST_WIRE_BUFFER)
+        quantity = HOST_WIRE_BUFFER;
+    for (uint8_t i = 0; i < n; ++i)
+        found[i]->start(true);
+    for (; _rxLen < quantity; ++_rxLen) {
+        uint8_t b = 0xFF;
+        for (uint8_t i = 0; i < n; ++i)
+            b &= found[i]->transmit();
+        _rx[_rxLen] = b;
+    }
+    for (uint8_t i = 0; i < n; ++i)
+        found[i]->stop();
+    bytes += _rxLen;
+    return _rxLen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Test helpers
+
+static unsigned host_failed = 0;
+
+void host_check(bool ok, const char *what, const char *file, int line) {
+    if (ok)
+        return;
+    if (++host_failed <= 20)
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+}
+
+int host_report(const char *name) {
+    printf("%s: %s\n", name, host_failed ? "FAILED" : "ok");
+    if (host_failed)
+        fprintf(stderr, "%s: %u checks failed\n", name, host_failed);
+    return host_failed ? 1 : 0;
+}
+
+// The limit for a benchmark from a thresholds file, 0 if it has none
+double host_bench_limit(const char *path, const char *name) {
+    FILE *f = path ? fopen(path, "r") : 0;
+    if (!f)
+        return 0;
+    char line[128], key[64];
+    double ns, limit = 0;
+    while (fgets(line, sizeof(line), f))
+        if (line[0] != '#' && sscanf(line, "%63s %lf", key, &ns) == 2 && strcmp(key, name) == 0)
+            limit = ns;
+    fclose(f);
+    return limit;
+}
@@ -0,0 +1,27 @@
+// Checks and timing for the host tests and benchmarks
+// Released to the public domain! Enjoy!
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <time.h>
+
+// Counts a failure and prints the first few; a test keeps going after one
+#define CHECK(cond) host_check((cond), #cond, __FILE__, __LINE__)
+
+void host_check(bool ok, const char *what, const char *file, int line);
+// Prints the verdict; returns the exit code for main()
+int host_report(const char *name);
+
+// The ns/op limit of a benchmark from a thresholds file (lines of name and
+// limit, # for comments); 0 if the file or the name is missing
+double host_bench_limit(const char *path, const char *name);
+
+// Wall clock nanoseconds, for the benchmarks
+inline double host_wall_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#endif // _HOST_TEST_H_
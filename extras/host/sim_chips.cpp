@@ -0,0 +1,288 @@
+// Simulated RTC chips for the host tests
+// Released to the public domain! Enjoy!
+
+#include "sim_chips.h"
+#include "RTClibExtended.h"
+
+static uint8_t bcd2bin(uint8_t val) { return val - 6 * (val >> 4); }
+
+static uint8_t bin2bcd(uint8_t val) { return val + 6 * (val / 10); }
+
+////////////////////////////////////////////////////////////////////////////////
+// HostRtcChip implementation
+
+HostRtcChip::HostRtcChip(uint8_t size, uint8_t timeReg) :
+        ppm(0),
+        tickAfterBytes(0),
+        reads(0),
+        writes(0),
+        _size(size),
+        _timeReg(timeReg),
+        _latchOnWrap(true),
+        _ptr(0),
+        _pointerSet(false),
+        _timeWritten(false),
+        _readBytes(0) {
+    memset(regs, 0, sizeof(regs));
+    set(SECONDS_FROM_1970_TO_2000);
+}
+
+// Restarts the seconds countdown, as writing the seconds register does
+void HostRtcChip::set(uint32_t unixtime) {
+    _base = unixtime;
+    _baseFrac = 0;
+    _baseUs = host_us;
+}
+
+uint32_t HostRtcChip::unixtime() const {
+    return _base + (uint32_t) (_baseFrac + (host_us - _baseUs) * (1 + rateError() * 1e-6) / 1e6);
+}
+
+// Moves the base to now, keeping the phase, so the rate can change
+void HostRtcChip::rebase() {
+    double t = _baseFrac + (host_us - _baseUs) * (1 + rateError() * 1e-6) / 1e6;
+    uint32_t whole = (uint32_t) t;
+    _base += whole;
+    _baseFrac = t - whole;
+    _baseUs = host_us;
+}
+
+void HostRtcChip::start(bool read) {
+    _pointerSet = read;
+    _readBytes = 0;
+    if (read)
+        ++reads;
+    else
+        ++writes;
+    latch();
+}
+
+void HostRtcChip::receive(uint8_t data) {
+    if (!_pointerSet) {
+        _ptr = data < _size ? data : 0;
+        _pointerSet = true;
+        return;
+    }
+    written(_ptr, data);
+    if (++_ptr == _size)
+        _ptr = 0;
+}
+
+uint8_t HostRtcChip::transmit() {
+    if (tickAfterBytes && ++_readBytes == tickAfterBytes) {
+        tickAfterBytes = 0;
+        _base += 1;
+    }
+    uint8_t data = regs[_ptr];
+    if (++_ptr == _size) {
+        _ptr = 0;
+        if (_latchOnWrap)
+            latch();
+    }
+    return data;
+}
+
+void HostRtcChip::stop() {
+    if (_timeWritten)
+        timeWritten();
+    _timeWritten = false;
+}
+
+// Seconds, minutes, hours, weekday, date, month, year
+void HostRtcChip::latch() {
+    DateTime t(unixtime());
+    uint8_t *r = regs + _timeReg;
+    r[0] = bin2bcd(t.second());
+    r[1] = bin2bcd(t.minute());
+    r[2] = bin2bcd(t.hour());
+    r[3] = t.dayOfTheWeek() + 1;
+    r[4] = bin2bcd(t.day());
+    r[5] = bin2bcd(t.month());
+    r[6] = bin2bcd(t.year() - 2000);
+}
+
+void HostRtcChip::written(uint8_t reg, uint8_t value) {
+    regs[reg] = value;
+    if (reg >= _timeReg && reg < _timeReg + 7)
+        _timeWritten = true;
+}
+
+void HostRtcChip::timeWritten() {
+    const uint8_t *r = regs + _timeReg;
+    set(DateTime(bcd2bin(r[6]) + 2000, bcd2bin(r[5] & 0x1F), bcd2bin(r[4] & 0x3F),
+                 bcd2bin(r[2] & 0x3F), bcd2bin(r[1] & 0x7F), bcd2bin(r[0] & 0x7F)).unixtime());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HostDS1307 implementation
+//
+// The seconds register keeps CH (clock halt), set at power-up; the clock is
+// not stopped by it here, only reported.
+
+HostDS1307::HostDS1307() :
+        HostRtcChip(64),
+        _halted(true) {
+    regs[DS1307_CONTROL] = 0x03;        // OUT 0, SQWE 0, RS 11
+}
+
+void HostDS1307::latch() {
+    HostRtcChip::latch();
+    if (_halted)
+        regs[0] |= 0x80;
+}
+
+void HostDS1307::timeWritten() {
+    _halted = regs[0] & 0x80;
+    HostRtcChip::timeWritten();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HostDS3231 implementation
+
+HostDS3231::HostDS3231() :
+        HostRtcChip(DS3231_TEMP + 2),
+        temperature(25 * 4),
+        conversions(0),
+        _aging(0) {
+    regs[DS3231_CONTROL] = 0x1C;        // INTCN, RS2, RS1
+    regs[DS3231_STATUSREG] = 0x88;      // OSF, EN32kHz
+}
+
+void HostDS3231::latch() {
+    HostRtcChip::latch();
+    regs[DS3231_TEMP] = (uint16_t) temperature >> 2;
+    regs[DS3231_TEMP + 1] = temperature << 6;
+}
+
+double HostDS3231::rateError() const {
+    return ppm - _aging * 0.1;
+}
+
+void HostDS3231::written(uint8_t reg, uint8_t value) {
+    switch (reg) {
+    case DS3231_CONTROL:
+        if (value & 0x20) {
+            ++conversions;
+            rebase();
+            _aging = (int8_t) regs[DS3231_AGING_OFFSET];
+        }
+        regs[reg] = value & ~0x20;
+        break;
+    case DS3231_STATUSREG:
+        // OSF, A2F and A1F can only be cleared, BSY is read only
+        regs[reg] = (regs[reg] & value & 0x83) | (value & 0x78);
+        break;
+    case DS3231_TEMP:
+    case DS3231_TEMP + 1:
+        break;
+    default:
+        HostRtcChip::written(reg, value);
+        break;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// HostPCF8523 implementation
+
+// Source clock periods of Pcf8523TimerClockFreq, in microseconds
+static const uint64_t pcf8523_tick_us[] = { 244, 15625, 1000000ULL, 60000000ULL, 3600000000ULL };
+
+HostPCF8523::HostPCF8523() :
+        HostRtcChip(PCF8523_TIMER_B_VALUE + 1, 3),
+        _oscStopped(true) {
+    _latchOnWrap = false;
+    regs[PCF8523_CONTROL_3] = 0xE0;     // battery switchover off
+    for (uint8_t i = 0; i < 2; ++i) {
+        pulses[i] = asserts[i] = 0;
+        _timerPeriod[i] = 0;
+    }
+}
+
+void HostPCF8523::start(bool read) {
+    sync();
+    HostRtcChip::start(read);
+}
+
+/**
+ * @brief Bring the timer flags and INT1 counts up to the host clock
+ */
+void HostPCF8523::sync() {
+    static const uint8_t flag[2] = { 0x40, 0x20 };      // CTAF, CTBF
+    static const uint8_t enable[2] = { 0x02, 0x01 };    // CTAIE, CTBIE
+    static const uint8_t pulsed[2] = { 0x80, 0x40 };    // TAM, TBM
+    for (uint8_t i = 0; i < 2; ++i) {
+        if (!_timerPeriod[i])
+            continue;
+        uint32_t expired = (host_us - _timerStart[i]) / _timerPeriod[i];
+        if (expired == _timerExpired[i])
+            continue;
+        if (regs[PCF8523_CONTROL_2] & enable[i]) {
+            if (regs[PCF8523_CLKOUTCONTROL] & pulsed[i])
+                pulses[i] += expired - _timerExpired[i];
+            else if (!(regs[PCF8523_CONTROL_2] & flag[i]))
+                ++asserts[i];
+        }
+        regs[PCF8523_CONTROL_2] |= flag[i];
+        _timerExpired[i] = expired;
+    }
+}
+
+// INT1 held low by a permanent mode timer interrupt
+bool HostPCF8523::intLow() const {
+    uint8_t ctrl2 = regs[PCF8523_CONTROL_2], clk = regs[PCF8523_CLKOUTCONTROL];
+    return ((ctrl2 & 0x42) == 0x42 && !(clk & 0x80)) || ((ctrl2 & 0x21) == 0x21 && !(clk & 0x40));
+}
+
+void HostPCF8523::startTimer(uint8_t timer) {
+    uint8_t freq = regs[timer ? PCF8523_TIMER_B_FRCTL : PCF8523_TIMER_A_FRCTL] & 0x07;
+    uint8_t value = regs[timer ? PCF8523_TIMER_B_VALUE : PCF8523_TIMER_A_VALUE];
+    _timerStart[timer] = host_us;
+    _timerPeriod[timer] = value ? pcf8523_tick_us[freq > 4 ? 4 : freq] * value : 0;
+    _timerExpired[timer] = 0;
+}
+
+// Seconds, minutes, hours, day, weekday, month, year from register 3
+void HostPCF8523::latch() {
+    DateTime t(unixtime());
+    regs[3] = bin2bcd(t.second()) | (_oscStopped ? 0x80 : 0);
+    regs[4] = bin2bcd(t.minute());
+    regs[5] = bin2bcd(t.hour());
+    regs[6] = bin2bcd(t.day());
+    regs[7] = t.dayOfTheWeek();
+    regs[8] = bin2bcd(t.month());
+    regs[9] = bin2bcd(t.year() - 2000);
+}
+
+void HostPCF8523::written(uint8_t reg, uint8_t value) {
+    uint8_t old = regs[reg];
+    switch (reg) {
+    case PCF8523_CONTROL_2:
+        // WTAF is read only; CTAF, CTBF, SF and AF can only be cleared
+        regs[reg] = (old & 0x80) | (old & value & 0x78) | (value & 0x07);
+        break;
+    case PCF8523_CLKOUTCONTROL:
+        regs[reg] = value;
+        if ((value & 0x06) != (old & 0x06)) {
+            if ((value & 0x06) == 0x02)
+                startTimer(0);
+            else
+                _timerPeriod[0] = 0;
+        }
+        if ((value & 0x01) != (old & 0x01)) {
+            if (value & 0x01)
+                startTimer(1);
+            else
+                _timerPeriod[1] = 0;
+        }
+        break;
+    default:
+        HostRtcChip::written(reg, value);
+        break;
+    }
+}
+
+void HostPCF8523::timeWritten() {
+    _oscStopped = regs[3] & 0x80;
+    set(DateTime(bcd2bin(regs[9]) + 2000, bcd2bin(regs[8] & 0x1F), bcd2bin(regs[6] & 0x3F),
+                 bcd2bin(regs[5] & 0x3F), bcd2bin(regs[4] & 0x7F), bcd2bin(regs[3] & 0x7F)).unixtime());
+}
@@ -0,0 +1,110 @@
+// Simulated RTC chips for the host tests
+// Released to the public domain! Enjoy!
+//
+// Each chip keeps its time as a start value plus the host clock since then,
+// scaled by a rate error, and shows it through a register file with the
+// chip's pointer wrap. The DS1307 and DS3231 copy the time registers to a
+// buffer at START and when the pointer wraps to 0, as their datasheets
+// describe; a read that spans a wrap can therefore see two different
+// seconds. tickAfterBytes makes that happen on purpose. The PCF8523 holds
+// its time still for the whole access.
+
+#ifndef _SIM_CHIPS_H_
+#define _SIM_CHIPS_H_
+
+#include <Wire.h>
+
+class HostRtcChip : public HostI2CDevice {
+public:
+    HostRtcChip(uint8_t size, uint8_t timeReg = 0);
+
+    void set(uint32_t unixtime);
+    uint32_t unixtime() const;
+    void rebase();
+
+    void start(bool read);
+    void receive(uint8_t data);
+    uint8_t transmit();
+    void stop();
+
+    uint8_t regs[64];
+    double ppm;                 // rate error, positive runs fast; call rebase() before changing it
+    uint8_t tickAfterBytes;     // the next read sees a second tick after this many bytes; 0 for none
+    uint32_t reads, writes;     // transactions addressed to this chip
+
+protected:
+    virtual double rateError() const    { return ppm; }
+    virtual void latch();
+    virtual void written(uint8_t reg, uint8_t value);
+    virtual void timeWritten();
+
+    uint8_t _size;
+    uint8_t _timeReg;           // seconds register, the first of seven
+    bool _latchOnWrap;
+    uint8_t _ptr;
+    bool _pointerSet;
+    bool _timeWritten;
+    uint8_t _readBytes;
+    uint32_t _base;
+    double _baseFrac;           // seconds into _base at _baseUs
+    uint64_t _baseUs;
+};
+
+// Registers 0x00..0x3F: time, control and 56 bytes of RAM
+class HostDS1307 : public HostRtcChip {
+public:
+    HostDS1307();
+
+protected:
+    void latch();
+    void timeWritten();
+
+    bool _halted;
+};
+
+// Registers 0x00..0x12. Conversions finish at once; temperature is in
+// quarter degrees and shows in 0x11/0x12 at the next latch. Each aging
+// offset LSB slows the clock by 0.1 ppm from the next conversion on.
+class HostDS3231 : public HostRtcChip {
+public:
+    HostDS3231();
+
+    int16_t temperature;
+    uint32_t conversions;
+
+protected:
+    double rateError() const;
+    void latch();
+    void written(uint8_t reg, uint8_t value);
+
+    int8_t _aging;              // aging offset in effect
+};
+
+// Registers 0x00..0x13, time at 0x03. The countdown timers run from the
+// host clock: sync() turns the time since they were enabled into flags and
+// INT1 activity, counted per timer in pulses (pulsed mode) and asserts
+// (permanent mode, INT1 going low).
+class HostPCF8523 : public HostRtcChip {
+public:
+    HostPCF8523();
+
+    void start(bool read);
+    void sync();
+    bool intLow() const;
+
+    uint32_t pulses[2];
+    uint32_t asserts[2];
+
+protected:
+    void latch();
+    void written(uint8_t reg, uint8_t value);
+    void timeWritten();
+    void startTimer(uint8_t timer);
+
+    bool _oscStopped;
+    uint64_t _timerStart[2];
+    uint64_t _timerPeriod[2];    // microseconds, 0 when the timer is off
+    uint32_t _timerExpired[2];
+};
+
+#endif // _SIM_CHIPS_H_
@@ -0,0 +1,83 @@
+// RTC_Auto chip detection against the three simulated chips
+// Released to the public domain! Enjoy!
+
+#include "RTCAutoDetect.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+static RtcProbeResult probe(HostI2CDevice *chip, uint32_t &transactions) {
+    Wire.detachAll();
+    if (chip)
+        Wire.attach(DS3231_ADDRESS, chip);
+    RtcProbeResult result;
+    uint32_t before = Wire.transactions;
+    RTC_Auto::probe(result);
+    transactions = Wire.transactions - before;
+    return result;
+}
+
+int main() {
+    DateTime t0(2027, 3, 4, 5, 6, 7);
+    uint32_t transactions;
+
+    HostDS3231 ds3231;
+    ds3231.set(t0.unixtime());
+    RtcProbeResult r = probe(&ds3231, transactions);
+    CHECK(r.type == RTC_CHIP_DS3231 && r.lostPower && r.now.unixtime() == t0.unixtime());
+    CHECK(transactions == 2);
+
+    // a second ticks during the burst, before the pointer wraps: the time
+    // copies differ, the read is repeated and the chip is still a DS3231
+    // with its OSF showing
+    for (uint8_t at = 1; at <= DS3231_TEMP + 2; ++at) {
+        ds3231.tickAfterBytes = at;
+        r = probe(&ds3231, transactions);
+        CHECK(r.type == RTC_CHIP_DS3231 && r.lostPower);
+        CHECK(r.now.unixtime() == t0.unixtime() + at);
+        CHECK(transactions == 4);
+    }
+
+    // after the wrap the tick is not seen
+    ds3231.set(t0.unixtime());
+    ds3231.tickAfterBytes = DS3231_TEMP + 3;
+    r = probe(&ds3231, transactions);
+    CHECK(r.type == RTC_CHIP_DS3231 && r.now.unixtime() == t0.unixtime());
+    CHECK(transactions == 2);
+    ds3231.regs[DS3231_STATUSREG] &= ~0x80;
+    CHECK(!probe(&ds3231, transactions).lostPower);
+
+    HostPCF8523 pcf8523;
+    pcf8523.set(t0.unixtime());
+    pcf8523.tickAfterBytes = 10;
+    r = probe(&pcf8523, transactions);
+    CHECK(r.type == RTC_CHIP_PCF8523 && r.lostPower && r.now.unixtime() == t0.unixtime());
+    CHECK(transactions == 2);
+
+    HostDS1307 ds1307;
+    ds1307.set(t0.unixtime());
+    ds1307.tickAfterBytes = 10;
+    r = probe(&ds1307, transactions);
+    CHECK(r.type == RTC_CHIP_DS1307 && r.lostPower && r.now.unixtime() == t0.unixtime());
+    CHECK(transactions == 2);
+
+    // RAM cleared and the square wave off: the RAM then repeats the control
+    // register and 0x08.., which looks like a DS3231 with a tick
+    Wire.attach(DS1307_ADDRESS, &ds1307);
+    RTC_DS1307::adjust(t0);
+    memset(ds1307.regs + DS1307_CONTROL, 0, 64 - DS1307_CONTROL);
+    r = probe(&ds1307, transactions);
+    CHECK(r.type == RTC_CHIP_DS1307 && !r.lostPower);
+    CHECK(transactions == 4);
+
+    r = probe(0, transactions);
+    CHECK(r.type == RTC_CHIP_NONE && transactions == 1);
+
+    // full detection and forwarding
+    Wire.detachAll();
+    Wire.attach(DS3231_ADDRESS, &pcf8523);
+    RTC_Auto rtc;
+    CHECK(rtc.begin() && rtc.type() == RTC_CHIP_PCF8523);
+    rtc.adjust(t0);
+    CHECK(rtc.now().unixtime() == t0.unixtime());
+    return host_report("test_autodetect");
+}
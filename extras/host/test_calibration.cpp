@@ -0,0 +1,137 @@
+// RTC_DS3231_Calibrator against a simulated drifting DS3231
+// Released to the public domain! Enjoy!
+
+#include "RTCCalibration.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+#include <math.h>
+
+static uint32_t rng = 12345;
+
+static uint32_t next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// The reference: truth is refBase seconds at host time refBaseUs
+static uint32_t refBase;
+static uint64_t refBaseUs;
+static bool refOk = true;
+
+static bool reference(uint32_t &unixtime, int16_t &ms) {
+    uint64_t us = host_us - refBaseUs;
+    unixtime = refBase + (uint32_t) (us / 1000000);
+    ms = (int16_t) (us % 1000000 / 1000);
+    return refOk;
+}
+
+// Starts the chip at a random phase against the reference
+static void start(HostDS3231 &chip, double ppm) {
+    chip.ppm = ppm;
+    refBase = DateTime(2027, 5, 1, 0, 0, 0).unixtime();
+    refBaseUs = host_us;
+    host_advance_us(next_random() % 1000000);
+    chip.set(refBase + 1);
+    host_advance_us(next_random() % 1000000);
+}
+
+// Samples every 4 hours, plus up to a second, for 28 hours
+static bool calibrate(RTC_DS3231 &rtc, RTC_DS3231_Calibrator &cal) {
+    for (uint8_t i = 0; i < DS3231_CAL_SAMPLES; ++i) {
+        if (i)
+            host_advance_us(4 * 3600 * 1000000ULL + next_random() % 1000000);
+        if (!cal.sampleAtTick(rtc, reference))
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    HostDS3231 chip;
+    Wire.attach(DS3231_ADDRESS, &chip);
+    RTC_DS3231 rtc;
+
+    // the fit is within a fraction of an aging LSB for any rate and phase
+    double worst = 0;
+    for (int run = 0; run < 200; ++run) {
+        double ppm = ((int32_t) (next_random() % 4001) - 2000) / 100.0;
+        start(chip, ppm);
+        chip.temperature = 60 + next_random() % 40;
+        RTC_DS3231_Calibrator cal;
+        CHECK(calibrate(rtc, cal));
+        float estimate;
+        CHECK(cal.estimate(estimate));
+        if (fabs(estimate - ppm) > worst)
+            worst = fabs(estimate - ppm);
+        CHECK(cal.meanTempQuarter() == chip.temperature);
+    }
+    CHECK(worst < 0.02);
+
+    // too short a span gives no estimate
+    {
+        start(chip, 5);
+        RTC_DS3231_Calibrator cal;
+        for (uint8_t i = 0; i < 4; ++i) {
+            host_advance_us(5 * 3600 * 1000000ULL);
+            CHECK(cal.sampleAtTick(rtc, reference));
+        }
+        float estimate;
+        int8_t offset;
+        CHECK(!cal.estimate(estimate));
+        CHECK(!cal.suggestedAgingOffset(offset));
+        CHECK(!cal.apply(rtc));
+    }
+
+    // apply() trims the oscillator; a second round finds nothing left to do
+    {
+        start(chip, 7.34);
+        uint32_t conversions = chip.conversions;
+        RTC_DS3231_Calibrator cal;
+        CHECK(calibrate(rtc, cal));
+        CHECK(cal.apply(rtc));
+        CHECK((int8_t) chip.regs[DS3231_AGING_OFFSET] == 73);
+        CHECK(chip.conversions == conversions + 1);
+        CHECK(cal.count() == 0 && cal.agingOffset() == 73);
+
+        CHECK(calibrate(rtc, cal));
+        float residual;
+        CHECK(cal.estimate(residual));
+        CHECK(fabs(residual - 0.04) < 0.02);
+        CHECK(!cal.apply(rtc));
+        CHECK(chip.conversions == conversions + 1);
+
+        // the state survives a save and restore, but not corruption
+        Ds3231CalState saved = cal.state();
+        RTC_DS3231_Calibrator restored;
+        CHECK(restored.restore(saved));
+        float again;
+        CHECK(restored.estimate(again) && again == residual);
+        CHECK(restored.agingOffset() == 73);
+        Ds3231CalState bad = saved;
+        bad.samples[2].offsetMs ^= 0x10;
+        CHECK(!restored.restore(bad));
+        bad = saved;
+        bad.count = DS3231_CAL_SAMPLES + 1;
+        bad.checksum = 0;
+        CHECK(!restored.restore(bad));
+        Ds3231CalState erased;
+        memset(&erased, 0xFF, sizeof(erased));
+        CHECK(!restored.restore(erased));
+        CHECK(restored.estimate(again) && again == residual);
+    }
+
+    // no reference, or no chip, gives no sample
+    {
+        RTC_DS3231_Calibrator cal;
+        refOk = false;
+        CHECK(!cal.sampleAtTick(rtc, reference));
+        refOk = true;
+        Wire.detachAll();
+        CHECK(!cal.sampleAtTick(rtc, reference));
+        CHECK(cal.count() == 0);
+    }
+    return host_report("test_calibration");
+}
@@ -0,0 +1,97 @@
+// DateTime and TimeSpan against the C library, every day from 2000 to 2099
+// Released to the public domain! Enjoy!
+
+#include <stdlib.h>
+#include <time.h>
+#include "RTClibExtended.h"
+#include "host_test.h"
+
+static const char *const month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static bool same_fields(const DateTime &d, const struct tm &g) {
+    return d.year() == g.tm_year + 1900 && d.month() == g.tm_mon + 1 && d.day() == g.tm_mday &&
+           d.hour() == g.tm_hour && d.minute() == g.tm_min && d.second() == g.tm_sec &&
+           d.dayOfTheWeek() == g.tm_wday;
+}
+
+// Both directions for four times of every day: unixtime to fields against
+// gmtime_r, fields to unixtime and secondstime against timegm
+static void test_calendar() {
+    static const uint32_t times[] = { 0, 1, 43199, 86399 };
+    for (uint32_t day = 0; day < 36525; ++day) {
+        for (uint8_t i = 0; i < 4; ++i) {
+            uint32_t t = SECONDS_FROM_1970_TO_2000 + day * 86400 + times[i];
+            time_t tt = t;
+            struct tm g;
+            gmtime_r(&tt, &g);
+            CHECK(same_fields(DateTime(t), g));
+
+            DateTime d(g.tm_year + 1900, g.tm_mon + 1, g.tm_mday, g.tm_hour, g.tm_min, g.tm_sec);
+            CHECK(d.unixtime() == (uint32_t) timegm(&g));
+            CHECK(d.secondstime() == (long) (t - SECONDS_FROM_1970_TO_2000));
+        }
+    }
+    CHECK(DateTime(2099, 12, 31, 23, 59, 59).unixtime() == 4102444799UL);
+}
+
+static void test_timespan() {
+    for (int32_t s = -400000; s <= 400000; s += 7) {
+        TimeSpan span(s);
+        CHECK(span.days() == s / 86400);
+        CHECK(span.hours() == s / 3600 % 24);
+        CHECK(span.minutes() == s / 60 % 60);
+        CHECK(span.seconds() == s % 60);
+        CHECK(TimeSpan(span.days(), span.hours(), span.minutes(), span.seconds()).totalseconds() == s);
+
+        TimeSpanFields f(span);
+        CHECK(f.days() == span.days() && f.hours() == span.hours() &&
+              f.minutes() == span.minutes() && f.seconds() == span.seconds());
+    }
+
+    TimeSpan a(3, 4, 5, 6), b(-1, 0, 0, 1);
+    CHECK((a + b).totalseconds() == 2 * 86400L + 4 * 3600 + 5 * 60 + 7);
+    CHECK((a - b).totalseconds() == 4 * 86400L + 4 * 3600 + 5 * 60 + 5);
+    CHECK(TimeSpan(a).totalseconds() == a.totalseconds());
+
+    // DateTime arithmetic across month, year and leap day boundaries
+    srand(2000);
+    for (int i = 0; i < 100000; ++i) {
+        uint32_t t = SECONDS_FROM_1970_TO_2000 + (uint32_t) rand() % 3000000000UL;
+        int32_t s = rand() % 20000000 - 10000000;
+        DateTime d(t);
+        if (t + s < SECONDS_FROM_1970_TO_2000 || t + s > 4102444799UL)
+            continue;
+        CHECK((d + TimeSpan(s)).unixtime() == t + s);
+        CHECK((d - TimeSpan(s)).unixtime() == t - s || t - s < SECONDS_FROM_1970_TO_2000);
+        CHECK((DateTime(t + s) - d).totalseconds() == s);
+    }
+    CHECK((DateTime(2024, 3, 1) - DateTime(2024, 2, 28)).days() == 2);
+    CHECK((DateTime(2099, 12, 31) + TimeSpan(0, 23, 59, 59)).hour() == 23);
+}
+
+// The __DATE__ / __TIME__ constructors, plain and F(), for every month
+static void test_strings() {
+    for (uint8_t m = 0; m < 12; ++m) {
+        for (uint8_t d = 1; d <= 28; d += 27) {
+            char date[12], time[9];
+            snprintf(date, sizeof(date), "%s %2d 20%02d", month_names[m], d, 13 + m);
+            snprintf(time, sizeof(time), "%02d:%02d:%02d", m, 59 - m, 7 + m);
+
+            DateTime a(date, time);
+            DateTime b(F(date), F(time));
+            CHECK(a.unixtime() == DateTime(2013 + m, m + 1, d, m, 59 - m, 7 + m).unixtime());
+            CHECK(b.unixtime() == a.unixtime());
+        }
+    }
+    CHECK(DateTime("Dec 26 2009", "12:34:56").unixtime() == 1261830896UL);
+    CHECK(DateTime(F("Jan  5 2021"), F("01:02:03")).unixtime() == 1609808523UL);
+}
+
+int main() {
+    test_calendar();
+    test_timespan();
+    test_strings();
+    return host_report("test_datetime");
+}
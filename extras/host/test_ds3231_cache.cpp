@@ -0,0 +1,82 @@
+// RTC_DS3231 bus guard and cached time for interrupt handlers
+// Released to the public domain! Enjoy!
+
+#include "RTClibExtended.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+// Calls now() in the middle of a read, like an interrupt handler on a core
+// whose interrupt context cannot be detected
+class InterruptedDS3231 : public HostDS3231 {
+public:
+    InterruptedDS3231() : interrupt(false), nested((uint32_t) 0) {}
+
+    uint8_t transmit() {
+        if (interrupt) {
+            interrupt = false;
+            nested = RTC_DS3231::now();
+        }
+        return HostDS3231::transmit();
+    }
+
+    bool interrupt;
+    DateTime nested;
+};
+
+int main() {
+    InterruptedDS3231 chip;
+    Wire.attach(DS3231_ADDRESS, &chip);
+    RTC_DS3231 rtc;
+    DateTime t0(2027, 8, 9, 10, 11, 12);
+    chip.set(t0.unixtime());
+
+    // before the first refresh() an ISR gets the documented empty value,
+    // with valid fields, and the bus is not touched
+    host_in_isr = true;
+    uint32_t transactions = Wire.transactions;
+    uint16_t rejections = rtc.busRejections();
+    DateTime t = rtc.now();
+    CHECK(t.unixtime() == DS3231_CACHE_EMPTY);
+    CHECK(t.year() == 2000 && t.month() == 1 && t.day() == 1 && t.hour() == 0);
+    CHECK(rtc.getTemp() == 0);
+    CHECK(!rtc.refresh());
+    Ds3231Snapshot snap;
+    CHECK(!rtc.snapshot(snap));
+    CHECK(Wire.transactions == transactions);
+    CHECK(rtc.busRejections() == rejections + 3);
+
+    // from the main context refresh() fills the cache
+    host_in_isr = false;
+    chip.temperature = 23 * 4 + 1;
+    CHECK(rtc.refresh());
+    CHECK(rtc.snapshot(snap) && snap.unixtime == t0.unixtime() && snap.tempQuarter == 93);
+
+    // an ISR reads the cache, advanced by millis(), and never the bus
+    host_advance_us(5500000);
+    host_in_isr = true;
+    transactions = Wire.transactions;
+    CHECK(rtc.now().unixtime() == t0.unixtime() + 5);
+    CHECK(rtc.getTemp() == 23.25);
+    CHECK(rtc.cachedUnixtime() == t0.unixtime() + 5);
+    rtc.adjust(DateTime(2030, 1, 1));
+    rtc.clearAlarm(1);
+    CHECK(!rtc.lostPower());
+    CHECK(Wire.transactions == transactions);
+    CHECK(chip.unixtime() == t0.unixtime() + 5);
+    host_in_isr = false;
+
+    // in the main context now() reads the chip
+    transactions = Wire.transactions;
+    CHECK(rtc.now().unixtime() == t0.unixtime() + 5);
+    CHECK(Wire.transactions == transactions + 2);
+
+    // a call made while a transaction is running is rejected and gets the
+    // cache; the outer read completes undisturbed
+    host_advance_us(2000000);
+    rejections = rtc.busRejections();
+    chip.interrupt = true;
+    CHECK(rtc.now().unixtime() == t0.unixtime() + 7);
+    CHECK(chip.nested.unixtime() == t0.unixtime() + 7);
+    CHECK(rtc.busRejections() == rejections + 1);
+    return host_report("test_ds3231_cache");
+}
@@ -0,0 +1,104 @@
+// RTC_DS3231_Sim alarm flags and wakeups, and RTC_EnergyModel charges
+// Released to the public domain! Enjoy!
+
+#include "RTCEnergyModel.h"
+#include "host_test.h"
+
+static uint32_t wakeups;
+
+static void onAlarm(RTC_DS3231_Sim &rtc, byte alarmNumber) {
+    ++wakeups;
+    rtc.clearAlarm(alarmNumber);
+}
+
+static void forgetful(RTC_DS3231_Sim &, byte) {
+    ++wakeups;
+}
+
+int main() {
+    RtcBoardProfile board;
+    board.wakeUc = 30;
+
+    // a day of minute alarms, each cleared
+    {
+        RTC_EnergyModel model(RTC_POWER_DS3231, board);
+        RTC_DS3231_Sim rtc(model);
+        rtc.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+        wakeups = 0;
+        rtc.run(86400, onAlarm);
+        CHECK(wakeups == 1440);
+        CHECK(model.elapsed() == 86400);
+        CHECK(model.chargeUc(RTC_ENERGY_ALARM) == 1440 * 30.0);
+    }
+
+    // an unarmed alarm still sets its flag but wakes nobody and leaves INT
+    // alone; arming it with the flag set pulls INT low until it is cleared
+    {
+        RTC_EnergyModel model(RTC_POWER_DS3231, board);
+        RTC_DS3231_Sim rtc(model);
+        rtc.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+        rtc.armAlarm(2, false);
+        CHECK(!(rtc.read(DS3231_STATUSREG) & 0x02));
+        wakeups = 0;
+        rtc.run(600, onAlarm);
+        CHECK(wakeups == 0);
+        CHECK(rtc.read(DS3231_STATUSREG) & 0x02);
+        CHECK(model.chargeUc(RTC_ENERGY_ALARM) == 0);
+
+        rtc.armAlarm(2, true);
+        CHECK(rtc.read(DS3231_CONTROL) & 0x02);
+        rtc.run(600, onAlarm);
+        CHECK(wakeups == 0);
+        CHECK(model.chargeUc(RTC_ENERGY_ALARM) > 0);
+
+        rtc.clearAlarm(2);
+        rtc.run(600, onAlarm);
+        CHECK(wakeups == 10);
+    }
+
+    // a handler that never clears the flag gets one wakeup
+    {
+        RTC_EnergyModel model(RTC_POWER_DS3231, board);
+        RTC_DS3231_Sim rtc(model);
+        rtc.setAlarm(ALM1_MATCH_SECONDS, 0, 0, 0, 0);
+        wakeups = 0;
+        rtc.run(3600, forgetful);
+        CHECK(wakeups == 1);
+        CHECK(rtc.read(DS3231_STATUSREG) & 0x01);
+    }
+
+    // on battery without BBSQW the flag is set but INT cannot be driven
+    {
+        RtcBoardProfile battery = board;
+        battery.rtcOnBattery = true;
+        RTC_EnergyModel model(RTC_POWER_DS3231, battery);
+        RTC_DS3231_Sim rtc(model);
+        rtc.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+        wakeups = 0;
+        rtc.run(3600, onAlarm);
+        CHECK(wakeups == 0);
+        CHECK(rtc.read(DS3231_STATUSREG) & 0x02);
+        rtc.setBBSQW(true);
+        CHECK(rtc.read(DS3231_CONTROL) & DS3231_BBSQW);
+        rtc.clearAlarm(2);
+        rtc.run(3600, onAlarm);
+        CHECK(wakeups == 60);
+    }
+
+    // the 32kHz output into a pull-up dominates an idle chip
+    {
+        RtcBoardProfile pulled = board;
+        pulled.clkPullupOhms = 10000;
+        RTC_EnergyModel model(RTC_POWER_DS3231, pulled);
+        RTC_DS3231_Sim rtc(model);
+        rtc.run(86400);
+        CHECK(model.chargeUc(RTC_ENERGY_32KHZ) > model.chargeUc(RTC_ENERGY_TIMEKEEPING));
+        float on = model.averageUa();
+        model.reset();
+        rtc.setEN32kHz(false);
+        rtc.run(86400);
+        CHECK(model.chargeUc(RTC_ENERGY_32KHZ) == 0);
+        CHECK(model.averageUa() < on / 2);
+    }
+    return host_report("test_energy_model");
+}
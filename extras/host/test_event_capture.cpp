@@ -0,0 +1,133 @@
+// RTC_EventCapture against synthetic event and square wave streams
+// Released to the public domain! Enjoy!
+//
+// The streams are generated in true seconds and turned into tick values of
+// a source that runs off nominal and wraps, as micros() does every 71
+// minutes. Every drained event is compared with the time it was made at.
+
+#include <stdlib.h>
+#include "RTCEventCapture.h"
+#include "host_test.h"
+
+#define UNIX0 1700000000UL
+
+// A tick source with a rate error, starting at an arbitrary value
+struct TickSource {
+    double rate;
+    uint32_t base;
+    uint32_t at(double seconds) const { return base + (uint32_t) (uint64_t) (seconds * rate); }
+};
+
+// Whether an event drained as e was made at `seconds` after UNIX0; the
+// millisecond is truncated, so e may be up to 1 ms early
+static bool near(const RtcEvent &e, double seconds, double toleranceMs = 1) {
+    double got = (double) (e.unixtime - UNIX0) + e.millis / 1000.0;
+    double err = (got - seconds) * 1000;
+    return err <= 0.5 && err >= -toleranceMs - 0.5;
+}
+
+struct FakeRtc {
+    DateTime now() { return DateTime(t); }
+    uint32_t t;
+};
+
+// An RTC whose read straddles a square wave edge
+struct EdgeDuringRead {
+    DateTime now() { capture->ppsEdge(tick); return DateTime(UNIX0); }
+    RTC_EventCapture *capture;
+    uint32_t tick;
+};
+
+// Random events every second for hours, drained every few seconds, with the
+// square wave anchoring; some edges are lost if dropEvery is set
+static void pps_stream(uint32_t ticksPerSecond, double ppm, uint32_t base, uint32_t seconds,
+                       uint32_t dropEvery, double toleranceMs) {
+    TickSource src = { ticksPerSecond * (1 + ppm * 1e-6), base };
+    RTC_EventCapture c(ticksPerSecond);
+    FakeRtc rtc = { UNIX0 };
+
+    CHECK(!c.anchorToEdge(rtc));
+    c.ppsEdge(src.at(0));
+    CHECK(c.anchorToEdge(rtc));
+
+    double made[RTC_EVENT_RING];
+    uint8_t head = 0, tail = 0;
+    uint32_t captured = 0, drained = 0, wrong = 0;
+    srand(seconds);
+    for (uint32_t s = 0; s < seconds; ++s) {
+        for (int k = rand() % 4; k > 0; --k) {
+            double t = s + (rand() % 1000) / 1000.0 + 0.0003;
+            c.capture(src.at(t));
+            made[head++ % RTC_EVENT_RING] = t;
+            ++captured;
+        }
+        if (!dropEvery || s % dropEvery != dropEvery - 1)
+            c.ppsEdge(src.at(s + 1));
+        if (s % 5 == 4) {
+            RtcEvent e[RTC_EVENT_RING];
+            uint8_t n = c.drain(e, RTC_EVENT_RING, src.at(s + 1.2));
+            for (uint8_t i = 0; i < n; ++i)
+                wrong += !near(e[i], made[tail++ % RTC_EVENT_RING], toleranceMs);
+            drained += n;
+        }
+    }
+    CHECK(wrong == 0);
+    CHECK(drained == captured);
+    CHECK(c.overflows() == 0);
+    double measured = c.ticksPerSecond() - src.rate;
+    CHECK(measured < 2 && measured > -2);
+}
+
+int main() {
+    // micros() 50 ppm fast, wrapping four times over five hours
+    pps_stream(1000000UL, 50, 0xFFF00000UL, 5 * 3600, 0, 1);
+    // 80 ppm slow, one edge in seven lost
+    pps_stream(1000000UL, -80, 0x80000000UL, 3600, 7, 1);
+    // a 32.768kHz tick source, one tick is 0.03 ms
+    pps_stream(32768, 20, 0xFFFF0000UL, 3600, 0, 1);
+
+    // events older than the anchor and a late drain
+    TickSource src = { 1000050, 0xFFFFF000UL };
+    RTC_EventCapture c;
+    FakeRtc rtc = { UNIX0 };
+    c.ppsEdge(src.at(0));
+    CHECK(c.anchorToEdge(rtc));
+    c.capture(src.at(100.25));
+    for (uint32_t s = 1; s <= 100; ++s)
+        c.ppsEdge(src.at(s));
+    c.capture(src.at(94.5));
+    RtcEvent e[RTC_EVENT_RING];
+    CHECK(c.drain(e, RTC_EVENT_RING, src.at(100.5)) == 2);
+    CHECK(near(e[0], 100.25) && near(e[1], 94.5));
+
+    // an edge during the RTC read is refused
+    EdgeDuringRead straddle = { &c, src.at(101) };
+    CHECK(!c.anchorToEdge(straddle));
+    rtc.t = UNIX0 + 101;
+    CHECK(c.anchorToEdge(rtc));
+
+    // a full ring drops and counts, then recovers
+    RTC_EventCapture full;
+    for (uint32_t i = 0; i < RTC_EVENT_RING + 8; ++i)
+        full.capture(i);
+    CHECK(full.pending() == RTC_EVENT_RING);
+    CHECK(full.overflows() == 8);
+    CHECK(full.drain(e, RTC_EVENT_RING, 0) == 0);     // not anchored: kept
+    full.anchor(UNIX0, 0);
+    CHECK(full.drain(e, RTC_EVENT_RING, RTC_EVENT_RING) == RTC_EVENT_RING);
+    full.capture(1000000UL);
+    CHECK(full.drain(e, 1, 1000000UL) == 1 && e[0].unixtime == UNIX0 + 1 && e[0].millis == 0);
+    CHECK(full.overflows() == 8);
+
+    // a manual anchor is carried across tick wraps
+    RTC_EventCapture manual;
+    manual.anchor(UNIX0, 5);
+    uint32_t ticks = 5;
+    for (uint32_t i = 1; i <= 20; ++i) {
+        ticks += 1000000000UL;
+        manual.capture(ticks + 250000);
+        CHECK(manual.drain(e, 1, ticks + 300000) == 1);
+        CHECK(e[0].unixtime == UNIX0 + 1000 * i && e[0].millis == 250);
+    }
+    return host_report("test_event_capture");
+}
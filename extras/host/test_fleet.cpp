@@ -0,0 +1,107 @@
+// RTC_DS3231_Fleet against DS3231s behind a simulated TCA9548A
+// Released to the public domain! Enjoy!
+
+#include "RTCFleet.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+static HostTCA9548A mux;
+static HostDS3231 chips[4];         // channels 0, 3, 5, and 6 outside the fleet
+
+static void attach() {
+    Wire.attach(TCA9548A_ADDRESS, &mux);
+    Wire.attach(DS3231_ADDRESS, &chips[0], &mux, 0);
+    Wire.attach(DS3231_ADDRESS, &chips[1], &mux, 3);
+    Wire.attach(DS3231_ADDRESS, &chips[2], &mux, 5);
+    Wire.attach(DS3231_ADDRESS, &chips[3], &mux, 6);
+}
+
+int main() {
+    attach();
+    RTC_DS3231_Fleet fleet;
+    fleet.begin();
+    CHECK(fleet.add(0) && fleet.add(3) && fleet.add(5));
+    CHECK(!fleet.add(8));
+    CHECK(fleet.size() == 3);
+
+    // one write reaches every clock of the fleet and only those
+    DateTime t0(2024, 5, 6, 7, 8, 9);
+    chips[3].set(DateTime(2001, 1, 1).unixtime());
+    uint32_t before = Wire.transactions;
+    CHECK(fleet.adjustAll(t0));
+    CHECK(Wire.transactions - before == 2);
+    for (uint8_t i = 0; i < 3; ++i)
+        CHECK(chips[i].unixtime() == t0.unixtime());
+    CHECK(chips[3].unixtime() == DateTime(2001, 1, 1).unixtime());
+    CHECK(mux.channels == (_BV(0) | _BV(3) | _BV(5)));
+
+    // sweep: a pointer reset to all clocks (the mux is still open to all of
+    // them after adjustAll), then a switch and a read per clock
+    host_advance_us(10500000);
+    RtcFleetReading r[RTC_FLEET_MAX];
+    RtcFleetReport report;
+    before = Wire.transactions;
+    CHECK(fleet.sweep(r, report) == 3);
+    CHECK(Wire.transactions - before == 1 + 2 * 3);
+    CHECK(report.valid == 3 && report.outliers == 0);
+    CHECK(report.median.unixtime() == t0.unixtime() + 10);
+    for (uint8_t i = 0; i < 3; ++i)
+        CHECK(r[i].ok && r[i].delta == 0 && !r[i].outlier);
+    CHECK(r[0].micros < r[1].micros && r[1].micros < r[2].micros);
+
+    // a clock that drifted 5 s is flagged against the median of the others
+    chips[1].set(chips[1].unixtime() + 5);
+    CHECK(fleet.sweep(r, report) == 2);
+    CHECK(report.outliers == 1 && r[1].outlier && r[1].delta == 5);
+    CHECK(fleet.sweep(r, report, 5) == 3);
+
+    // a fast crystal shows up after a simulated day
+    chips[1].set(chips[0].unixtime());
+    chips[2].ppm = 100;
+    host_advance_us(86400ULL * 1000000);
+    CHECK(fleet.sweep(r, report) == 2);
+    CHECK(r[2].outlier && r[2].delta >= 8 && r[2].delta <= 9);
+
+    // a channel with nothing on it
+    CHECK(fleet.add(7));
+    CHECK(fleet.sweep(r, report) == 2);
+    CHECK(report.valid == 3 && !r[3].ok);
+
+    // the selected channel is cached until invalidate()
+    uint16_t writes = fleet.muxWrites();
+    DateTime t;
+    CHECK(fleet.now(0, t) && t.unixtime() == chips[0].unixtime());
+    CHECK(fleet.now(0, t));
+    CHECK(fleet.muxWrites() == writes + 1);
+    CHECK(fleet.now(2, t) && t.unixtime() == chips[2].unixtime());
+    CHECK(fleet.muxWrites() == writes + 2);
+    fleet.invalidate();
+    CHECK(fleet.now(2, t));
+    CHECK(fleet.muxWrites() == writes + 3);
+
+    // nothing on the channel, or an index out of range
+    t = t0;
+    CHECK(!fleet.now(3, t) && t.unixtime() == t0.unixtime());
+    CHECK(!fleet.now(4, t) && t.unixtime() == t0.unixtime());
+
+    // the mux stops answering with clock 0 still routed: reading clock 2
+    // fails instead of returning clock 0's time
+    CHECK(fleet.now(0, t));
+    Wire.detachAll();
+    Wire.attach(DS3231_ADDRESS, &chips[0], &mux, 0);
+    Wire.attach(DS3231_ADDRESS, &chips[2], &mux, 5);
+    CHECK(mux.channels == _BV(0));
+    t = t0;
+    CHECK(!fleet.now(2, t) && t.unixtime() == t0.unixtime());
+    CHECK(!fleet.now(0, t) && t.unixtime() == t0.unixtime());
+    CHECK(fleet.sweep(r, report) == 0 && report.valid == 0);
+
+    // no mux: every call fails cleanly
+    Wire.detachAll();
+    fleet.invalidate();
+    CHECK(!fleet.adjustAll(t0));
+    CHECK(fleet.sweep(r, report) == 0 && report.valid == 0);
+    CHECK(!fleet.select(0));
+    CHECK(!fleet.now(0, t));
+    return host_report("test_fleet");
+}
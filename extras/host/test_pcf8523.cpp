@@ -0,0 +1,155 @@
+// RTC_PCF8523 countdown timers and offset register against a simulated chip
+// Released to the public domain! Enjoy!
+
+#include "RTClibExtended.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+#define SECONDS(s) ((uint64_t) (s) * 1000000)
+
+// Raises flags just before Control_2 is written after a read, as an alarm
+// going off in the middle of a read-modify-write would
+class RacyPCF8523 : public HostPCF8523 {
+public:
+    RacyPCF8523() : raise(0), _afterRead(false), _wasRead(false) {}
+
+    void start(bool read) {
+        HostPCF8523::start(read);
+        _wasRead = _afterRead;
+        _afterRead = read;
+    }
+
+    void receive(uint8_t data) {
+        if (!_pointerSet && data == PCF8523_CONTROL_2 && _wasRead) {
+            regs[PCF8523_CONTROL_2] |= raise;
+            raise = 0;
+        }
+        HostPCF8523::receive(data);
+    }
+
+    uint8_t raise;
+
+protected:
+    bool _afterRead, _wasRead;
+};
+
+static RacyPCF8523 chip;
+static RTC_PCF8523 rtc;
+
+static void test_time() {
+    CHECK(!rtc.initialized());
+    DateTime t0(2031, 7, 14, 22, 59, 58);
+    rtc.adjust(t0);
+    CHECK(rtc.initialized());
+    CHECK(rtc.now().unixtime() == t0.unixtime());
+    host_advance_us(SECONDS(3));
+    CHECK(rtc.now().unixtime() == t0.unixtime() + 3);
+}
+
+static void test_timers() {
+    // flags raised elsewhere must survive every timer call
+    chip.regs[PCF8523_CONTROL_2] |= 0x18;   // SF, AF
+    rtc.writeSqwPinMode(PCF8523_OFF);
+
+    // timer A, pulsed, every 10 s
+    rtc.enableCountdownTimer(PCF8523_TimerA, PCF8523_FrequencySecond, 10);
+    CHECK((chip.regs[PCF8523_CLKOUTCONTROL] & 0x86) == 0x82);   // TAM pulsed, TAC countdown
+    CHECK(chip.regs[PCF8523_TIMER_A_FRCTL] == PCF8523_FrequencySecond);
+    CHECK(chip.regs[PCF8523_TIMER_A_VALUE] == 10);
+    CHECK((chip.regs[PCF8523_CONTROL_2] & 0x1A) == 0x1A);       // CTAIE, SF, AF
+    CHECK(rtc.readSqwPinMode() == PCF8523_OFF);
+
+    // it reloads by itself: ten pulses in 100 s without a bus transaction
+    uint32_t before = Wire.transactions;
+    host_advance_us(SECONDS(100) + 1000);
+    chip.sync();
+    CHECK(Wire.transactions == before);
+    CHECK(chip.pulses[0] == 10);
+    CHECK(!chip.intLow());
+    CHECK(rtc.countdownFired(PCF8523_TimerA));
+
+    // timer B, permanent, every 5 s: INT1 stays low until the flag is cleared
+    rtc.enableCountdownTimer(PCF8523_TimerB, PCF8523_FrequencySecond, 5, false, PCF8523_LowPulse3x64Hz);
+    CHECK((chip.regs[PCF8523_CLKOUTCONTROL] & 0x41) == 0x01);   // TBM permanent, TBC on
+    CHECK(chip.regs[PCF8523_TIMER_B_FRCTL] == (PCF8523_LowPulse3x64Hz << 4 | PCF8523_FrequencySecond));
+    CHECK((chip.regs[PCF8523_CONTROL_2] & 0x5B) == 0x5B);       // CTAF, SF, AF, CTAIE, CTBIE
+    CHECK(!rtc.countdownFired(PCF8523_TimerB));
+
+    host_advance_us(SECONDS(12));
+    chip.sync();
+    CHECK(chip.asserts[1] == 1);
+    CHECK(chip.intLow());
+    CHECK(chip.pulses[0] == 11);
+    CHECK(rtc.countdownFired(PCF8523_TimerB));
+
+    rtc.clearCountdownFlag(PCF8523_TimerB);
+    CHECK(!chip.intLow());
+    CHECK(!rtc.countdownFired(PCF8523_TimerB));
+    CHECK((chip.regs[PCF8523_CONTROL_2] & 0x58) == 0x58);       // CTAF, SF, AF kept
+
+    host_advance_us(SECONDS(5));
+    chip.sync();
+    CHECK(chip.asserts[1] == 2 && chip.intLow());
+
+    // stopping A clears its flag and enable only
+    rtc.disableCountdownTimer(PCF8523_TimerA);
+    CHECK((chip.regs[PCF8523_CLKOUTCONTROL] & 0x06) == 0);
+    CHECK((chip.regs[PCF8523_CONTROL_2] & 0x7B) == 0x39);       // CTBF, SF, AF, CTBIE
+    host_advance_us(SECONDS(30));
+    chip.sync();
+    CHECK(chip.pulses[0] == 11);        // none after the stop
+
+    rtc.disableCountdownTimer(PCF8523_TimerB);
+    CHECK((chip.regs[PCF8523_CLKOUTCONTROL] & 0x01) == 0);
+    CHECK((chip.regs[PCF8523_CONTROL_2] & 0x7B) == 0x18);       // SF, AF
+    CHECK(!chip.intLow());
+
+    // CLKOUT changes leave the timer bits alone
+    rtc.enableCountdownTimer(PCF8523_TimerB, PCF8523_Frequency64Hz, 64);
+    rtc.writeSqwPinMode(PCF8523_SquareWave1HZ);
+    CHECK((chip.regs[PCF8523_CLKOUTCONTROL] & 0x41) == 0x41);
+    CHECK(rtc.readSqwPinMode() == PCF8523_SquareWave1HZ);
+    rtc.disableCountdownTimer(PCF8523_TimerB);
+}
+
+// A flag set between the read and the write of Control_2 is written back as 1
+static void test_flag_race() {
+    chip.regs[PCF8523_CONTROL_2] &= ~0x08;
+    chip.raise = 0x08;                      // AF
+    rtc.enableCountdownTimer(PCF8523_TimerA, PCF8523_FrequencySecond, 1);
+    CHECK(chip.regs[PCF8523_CONTROL_2] & 0x08);
+
+    chip.regs[PCF8523_CONTROL_2] &= ~0x08;
+    chip.raise = 0x08;
+    rtc.clearCountdownFlag(PCF8523_TimerA);
+    CHECK(chip.regs[PCF8523_CONTROL_2] & 0x08);
+
+    chip.regs[PCF8523_CONTROL_2] &= ~0x08;
+    chip.raise = 0x08;
+    rtc.disableCountdownTimer(PCF8523_TimerA);
+    CHECK(chip.regs[PCF8523_CONTROL_2] & 0x08);
+}
+
+static void test_offset() {
+    Pcf8523OffsetMode mode;
+    rtc.writeOffset(PCF8523_OneMinute, -5);
+    CHECK(rtc.readOffset(mode) == -5 && mode == PCF8523_OneMinute);
+    rtc.writeOffset(PCF8523_TwoHours, 63);
+    CHECK(rtc.readOffset(mode) == 63 && mode == PCF8523_TwoHours);
+
+    // a clock 13 ppm fast needs three 4.34 ppm steps down
+    CHECK(rtc.calibrate(PCF8523_TwoHours, 13.0) == -3);
+    CHECK(rtc.readOffset(mode) == -3);
+    CHECK(rtc.calibrate(PCF8523_OneMinute, -1000) == 63);
+    CHECK(rtc.calibrate(PCF8523_OneMinute, 1000) == -64);
+    CHECK(rtc.calibrate(PCF8523_TwoHours, 0) == 0);
+}
+
+int main() {
+    Wire.attach(PCF8523_ADDRESS, &chip);
+    test_time();
+    test_timers();
+    test_flag_race();
+    test_offset();
+    return host_report("test_pcf8523");
+}
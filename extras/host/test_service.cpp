@@ -0,0 +1,114 @@
+// RTC_DS3231_Service under load from many threads, against a simulated DS3231
+// Released to the public domain! Enjoy!
+//
+// The simulated chip takes the real time of a 100kHz bus for every byte, so
+// batching shows: the number of bus reads stays far below the number of
+// requests. Prints the throughput and latency percentiles.
+
+#include <vector>
+#include "RTCService.h"
+#include "sim_chips.h"
+#include "host_test.h"
+
+#define CLIENTS                 16
+#define CALLS_PER_CLIENT        500
+
+// 9 clocks per byte at 100kHz, spent in real time
+class SlowDS3231 : public HostDS3231 {
+public:
+    void receive(uint8_t data)  { wait(); HostDS3231::receive(data); }
+    uint8_t transmit()          { wait(); return HostDS3231::transmit(); }
+
+protected:
+    void wait() {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(90);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+};
+
+static SlowDS3231 chip;
+static RTC_DS3231 rtc;
+static const uint32_t start = DateTime(2030, 1, 1, 0, 0, 0).unixtime();
+
+static void load(RTC_DS3231_Service &service, std::atomic<int> &wrong) {
+    std::vector<std::thread> clients;
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(std::thread([&service, &wrong, i] {
+            for (int k = 0; k < CALLS_PER_CLIENT; ++k) {
+                if (i % 4 == 0) {
+                    float t;
+                    if (!service.temperature(t) || t != 21.25f)
+                        ++wrong;
+                } else {
+                    DateTime d;
+                    if (!service.now(d) || d.unixtime() != start)
+                        ++wrong;
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < clients.size(); ++i)
+        clients[i].join();
+}
+
+// Clients keep calling while stop() runs: each call must either be answered
+// correctly or refused, and stop() must not return with a client waiting
+static void stop_under_load() {
+    RTC_DS3231_Service service(rtc);
+    std::atomic<int> wrong(0), answered(0);
+    std::atomic<bool> quit(false);
+    service.start();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(std::thread([&] {
+            while (!quit.load()) {
+                DateTime d;
+                if (service.now(d)) {
+                    ++answered;
+                    if (d.unixtime() != start)
+                        ++wrong;
+                }
+            }
+        }));
+    }
+    while (answered.load() < 200)
+        std::this_thread::yield();
+    service.stop();
+    quit.store(true);
+    for (size_t i = 0; i < clients.size(); ++i)
+        clients[i].join();
+    CHECK(wrong.load() == 0);
+    CHECK(service.requests() == (uint32_t) answered.load());
+}
+
+int main() {
+    Wire.attach(DS3231_ADDRESS, &chip);
+    chip.set(start);
+    chip.temperature = 85;      // 21.25 degrees
+
+    RTC_DS3231_Service service(rtc);
+    DateTime d;
+    CHECK(!service.now(d));
+    CHECK(service.start());
+    CHECK(!service.start());
+
+    std::atomic<int> wrong(0);
+    double t0 = host_wall_ns();
+    load(service, wrong);
+    double seconds = (host_wall_ns() - t0) / 1e9;
+    service.stop();
+
+    uint32_t total = CLIENTS * CALLS_PER_CLIENT;
+    CHECK(wrong.load() == 0);
+    CHECK(service.requests() == total);
+    CHECK(service.busReads() < total / 4);
+    CHECK(!service.now(d));
+    printf("%u requests from %d threads in %.2f s: %.0f requests/s, %u bus reads\n",
+           service.requests(), CLIENTS, seconds, total / seconds, service.busReads());
+    printf("latency p50 %u us, p99 %u us, p99.9 %u us\n", service.latencyPercentileUs(50),
+           service.latencyPercentileUs(99), service.latencyPercentileUs(99.9));
+
+    for (int i = 0; i < 10; ++i)
+        stop_under_load();
+    return host_report("test_service");
+}
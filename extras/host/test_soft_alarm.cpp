@@ -0,0 +1,181 @@
+// RTC_SoftAlarm matches and RTC_AlarmClock scheduling on the host clock
+// Released to the public domain! Enjoy!
+
+#include <stdlib.h>
+#include "RTCSoftAlarm.h"
+#include "host_test.h"
+
+#define UNIX0 1700000000UL
+
+// A clock running from the host clock, counting its reads
+struct HostClock {
+    HostClock() : base(UNIX0), reads(0) {}
+    DateTime now() { ++reads; return DateTime(base + (uint32_t) (host_us / 1000000)); }
+    uint32_t base;
+    uint32_t reads;
+};
+
+static const Ds3231_ALARM_TYPES_t types[] = {
+    ALM1_EVERY_SECOND, ALM1_MATCH_SECONDS, ALM1_MATCH_MINUTES, ALM1_MATCH_HOURS, ALM1_MATCH_DATE,
+    ALM1_MATCH_DAY, ALM2_EVERY_MINUTE, ALM2_MATCH_MINUTES, ALM2_MATCH_HOURS, ALM2_MATCH_DATE, ALM2_MATCH_DAY
+};
+
+// The DS3231 matching rule, field by field
+static bool matches(Ds3231_ALARM_TYPES_t type, int s, int m, int h, int daydate, uint32_t t) {
+    DateTime d(t);
+    if (type & 0x80)
+        s = 0;
+    if ((type & 0x0F) == 0x0F)
+        return true;
+    if (d.second() != s)
+        return false;
+    if (type & 0x02)
+        return true;
+    if (d.minute() != m)
+        return false;
+    if (type & 0x04)
+        return true;
+    if (d.hour() != h)
+        return false;
+    if (type & 0x08)
+        return true;
+    return type & 0x10 ? d.dayOfTheWeek() + 1 == daydate : d.day() == daydate;
+}
+
+// next() returns a match, and for matches up to a week away no earlier one
+static void test_next() {
+    srand(3);
+    for (int k = 0; k < 5000; ++k) {
+        Ds3231_ALARM_TYPES_t type = types[rand() % 11];
+        int s = rand() % 60, m = rand() % 60, h = rand() % 24;
+        int daydate = type & 0x10 ? 1 + rand() % 7 : 1 + rand() % 31;
+        RTC_SoftAlarm alarm;
+        alarm.set(type, s, m, h, daydate);
+        uint32_t after = SECONDS_FROM_1970_TO_2000 + (uint32_t) rand() % (3000 * 86400UL), match;
+        CHECK(alarm.next(after, match));
+        CHECK(match > after && matches(type, s, m, h, daydate, match));
+        if (match - after <= 7 * 86400UL) {
+            uint32_t t = after + 1;
+            while (t < match && !matches(type, s, m, h, daydate, t))
+                ++t;
+            CHECK(t == match);
+        }
+    }
+
+    // the 31st skips the short months, and impossible fields never match
+    RTC_SoftAlarm alarm;
+    uint32_t match;
+    alarm.set(ALM1_MATCH_DATE, 0, 0, 12, 31);
+    CHECK(alarm.next(DateTime(2025, 4, 1).unixtime(), match) && match == DateTime(2025, 5, 31, 12).unixtime());
+    alarm.set(ALM1_MATCH_SECONDS, 75, 0, 0, 0);
+    CHECK(!alarm.next(UNIX0, match));
+}
+
+// An hour of polling every 10 ms: each alarm fires at its time, and the
+// clock is read about once per alarm rather than once per poll
+static void test_polling() {
+    HostClock clock;
+    RTC_AlarmClock<HostClock> alarms(clock);
+    host_us = 0;
+    alarms.setAlarm(ALM1_MATCH_SECONDS, 30, 0, 0, 0);
+    alarms.armAlarm(1, true);
+    alarms.setAlarm(ALM2_MATCH_MINUTES, 5, 0, 0);
+    alarms.armAlarm(2, true);
+
+    uint32_t fired1 = 0, fired2 = 0, late = 0;
+    for (uint32_t ms = 0; ms < 3600000UL; ms += 10) {
+        host_us = ms * 1000ULL;
+        uint8_t fired = alarms.poll();
+        DateTime t(UNIX0 + ms / 1000);
+        if (fired & 1) {
+            ++fired1;
+            late += t.second() != 30;
+            alarms.clearAlarm(1);
+        }
+        if (fired & 2) {
+            ++fired2;
+            late += t.minute() != 5 || t.second() != 0;
+        }
+    }
+    CHECK(fired1 == 60 && fired2 == 1 && late == 0);
+    CHECK(alarms.clockReads() < 3 * 62);
+    CHECK(alarms.alarmFired(2) && !alarms.alarmFired(1));
+}
+
+// Arming alarm 1 reads the clock after alarm 2 has passed unpolled: alarm 2
+// is due at once, not an hour later
+static void test_overdue() {
+    HostClock clock;
+    RTC_AlarmClock<HostClock> alarms(clock);
+    host_us = 0;
+    alarms.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+    alarms.armAlarm(2, true);
+    uint32_t due = alarms.deadline(2);
+
+    host_us = (due - UNIX0 + 2) * 1000000ULL;
+    alarms.setAlarm(ALM1_MATCH_HOURS, 0, 0, 0, 0);
+    alarms.armAlarm(1, true);
+    CHECK(alarms.msUntilNext() == 0);
+    CHECK(alarms.poll() == 2);
+    CHECK(alarms.deadline(2) == due + 60);
+    CHECK(alarms.msUntilNext() > 55000 && alarms.msUntilNext() <= 58000);
+    CHECK(alarms.poll() == 0);
+}
+
+// The call sequence of examples/wakeup_alarm: everything disarmed and
+// cleared, then setAlarm() alone arms alarm 1 for 18:33:00 daily. Sleeping
+// for msUntilNext() at a time, it fires once at its time, and the disarm
+// sequence after the wakeup keeps it quiet.
+static void test_wakeup_example() {
+    HostClock clock;
+    RTC_AlarmClock<HostClock> RTC(clock);
+    host_us = 0;
+
+    RTC.armAlarm(1, false);
+    RTC.clearAlarm(1);
+    RTC.alarmInterrupt(1, false);
+    RTC.armAlarm(2, false);
+    RTC.clearAlarm(2);
+    RTC.alarmInterrupt(2, false);
+    CHECK(!RTC.isArmed(1) && !RTC.isArmed(2));
+
+    RTC.setAlarm(ALM1_MATCH_HOURS, 33, 18, 0);
+    CHECK(RTC.isArmed(1) && !RTC.alarmFired(1));
+    RTC.alarmInterrupt(1, true);
+    CHECK(RTC.isArmed(1) && !RTC.isArmed(2));
+
+    uint8_t fired = 0;
+    uint16_t sleeps = 0;
+    while (!fired && sleeps < 1000) {
+        host_us += RTC.msUntilNext() * 1000ULL;
+        fired = RTC.poll();
+        ++sleeps;
+    }
+    DateTime t(UNIX0 + (uint32_t) (host_us / 1000000));
+    CHECK(fired == 1 && RTC.alarmFired(1));
+    CHECK(t.hour() == 18 && t.minute() == 33 && t.second() == 0);
+    CHECK(sleeps < 30);
+
+    RTC.armAlarm(1, false);
+    RTC.clearAlarm(1);
+    RTC.alarmInterrupt(1, false);
+    CHECK(!RTC.isArmed(1) && !RTC.alarmFired(1));
+    CHECK(RTC.msUntilNext() == 0xFFFFFFFFUL);
+    host_us += 3 * 86400 * 1000000ULL;
+    CHECK(RTC.poll() == 0);
+
+    // setting an alarm again clears a flag left from before
+    RTC.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+    host_us += 61 * 1000000ULL;
+    CHECK(RTC.poll() == 2 && RTC.alarmFired(2));
+    RTC.setAlarm(ALM2_EVERY_MINUTE, 0, 0, 0);
+    CHECK(!RTC.alarmFired(2) && RTC.isArmed(2));
+}
+
+int main() {
+    test_next();
+    test_polling();
+    test_overdue();
+    test_wakeup_example();
+    return host_report("test_soft_alarm");
+}
@@ -0,0 +1,206 @@
+// RTC_TimestampEncoder / RTC_TimestampDecoder round trips, seeking and
+// corrupt input
+// Released to the public domain! Enjoy!
+
+#include <stdlib.h>
+#include <vector>
+#include "RTCTimestampStream.h"
+#include "host_test.h"
+
+struct Record {
+    uint32_t t;
+    int16_t temp;
+};
+
+// Mostly a few seconds apart, with the odd long gap and step back
+static std::vector<Record> make_records(size_t n, bool monotonic) {
+    std::vector<Record> r(n);
+    uint32_t t = DateTime(2026, 1, 1).unixtime();
+    int16_t temp = 25 * 4;
+    for (size_t i = 0; i < n; ++i) {
+        int k = rand() % 100;
+        if (k < 90)
+            t += 1 + rand() % 10;
+        else if (k < 97 || monotonic)
+            t += rand() % 100000;
+        else
+            t -= rand() % 3600;
+        temp += rand() % 5 - 2;
+        if (rand() % 500 == 0)
+            temp = rand() % 400 - 200;
+        r[i].t = t;
+        r[i].temp = temp;
+    }
+    return r;
+}
+
+static size_t encode(const std::vector<Record> &r, std::vector<uint8_t> &buf, uint8_t interval, bool temps) {
+    RTC_TimestampEncoder enc(buf.data(), buf.size(), interval, temps);
+    size_t n = 0;
+    while (n < r.size() && enc.append(r[n].t, r[n].temp))
+        ++n;
+    CHECK(enc.count() == n);
+    buf.resize(enc.length());
+    return n;
+}
+
+// Decodes everything; returns how many records, with same set if they are
+// the first ones of r
+static size_t decode(const uint8_t *data, size_t len, const std::vector<Record> &r, bool temps, bool &same) {
+    RTC_TimestampDecoder dec(data, len);
+    uint32_t t;
+    int16_t temp;
+    size_t n = 0;
+    same = true;
+    while (dec.next(t, temp)) {
+        if (n >= r.size() || t != r[n].t || temp != (temps ? r[n].temp : 0))
+            same = false;
+        if (++n > len)
+            break;
+    }
+    return n;
+}
+
+static void test_round_trip() {
+    static const uint8_t intervals[] = { 1, 2, 7, 32, 255 };
+    for (uint8_t temps = 0; temps < 2; ++temps) {
+        for (size_t k = 0; k < sizeof(intervals); ++k) {
+            std::vector<Record> r = make_records(5000, false);
+            std::vector<uint8_t> buf(64 * 1024);
+            CHECK(encode(r, buf, intervals[k], temps) == r.size());
+            bool same;
+            CHECK(decode(buf.data(), buf.size(), r, temps, same) == r.size() && same);
+
+            RTC_TimestampDecoder dec(buf.data(), buf.size());
+            CHECK(dec.valid() && dec.hasTemps() == (bool) temps);
+            uint32_t t;
+            for (int i = 0; i < 10; ++i)
+                dec.next(t);
+            dec.rewind();
+            CHECK(dec.next(t) && t == r[0].t);
+        }
+    }
+
+    // a few seconds apart costs one byte per record, two with temperatures
+    std::vector<Record> r(1000);
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i].t = 1800000000UL + i * 5;
+        r[i].temp = 100 + (i & 1);
+    }
+    std::vector<uint8_t> buf(4096);
+    encode(r, buf, 100, false);
+    CHECK(buf.size() == RTC_TS_HEADER_SIZE + 10 * 6 + 990);
+    buf.resize(4096);
+    encode(r, buf, 100, true);
+    CHECK(buf.size() == RTC_TS_HEADER_SIZE + 10 * 8 + 990 * 2);
+}
+
+// A full buffer refuses the record and keeps what it has; the counter goes
+// past 65535 records
+static void test_full() {
+    std::vector<Record> r = make_records(2000, false);
+    std::vector<uint8_t> buf(1000);
+    RTC_TimestampEncoder enc(buf.data(), buf.size(), 16, true);
+    size_t n = 0;
+    while (enc.append(r[n].t, r[n].temp))
+        ++n;
+    size_t len = enc.length();
+    std::vector<uint8_t> copy(buf.begin(), buf.begin() + len);
+    CHECK(!enc.append(r[n].t, r[n].temp) && enc.length() == len && enc.count() == n);
+    CHECK(memcmp(copy.data(), buf.data(), len) == 0);
+    bool same;
+    CHECK(decode(buf.data(), len, r, true, same) == n && same);
+
+    enc.reset();
+    CHECK(enc.count() == 0 && enc.length() == RTC_TS_HEADER_SIZE);
+
+    std::vector<uint8_t> big(200000);
+    RTC_TimestampEncoder many(big.data(), big.size(), 32);
+    for (uint32_t i = 0; i < 70000; ++i)
+        CHECK(many.append(1800000000UL + i));
+    CHECK(many.count() == 70000);
+    RTC_TimestampDecoder dec(big.data(), many.length());
+    uint32_t t, decoded = 0;
+    while (dec.next(t))
+        CHECK(t == 1800000000UL + decoded++);
+    CHECK(decoded == 70000);
+}
+
+// seek() lands on the last keyframe at or before t, from which next() reaches t
+static void test_seek() {
+    std::vector<Record> r = make_records(3000, true);
+    std::vector<uint8_t> buf(32 * 1024);
+    encode(r, buf, 16, false);
+    RTC_TimestampDecoder dec(buf.data(), buf.size());
+    for (int k = 0; k < 500; ++k) {
+        size_t i = rand() % r.size();
+        CHECK(dec.seek(r[i].t));
+        uint32_t t, first = 0;
+        size_t steps = 0;
+        bool found = false;
+        while (dec.next(t)) {
+            if (!steps++)
+                first = t;
+            if (t >= r[i].t) {
+                found = t == r[i].t;
+                break;
+            }
+        }
+        CHECK(found && first <= r[i].t && steps <= 16);
+    }
+    uint32_t t;
+    CHECK(dec.seek(0) && dec.next(t) && t == r[0].t);
+    CHECK(dec.seek(0xFFFFFFFFUL) && dec.next(t) && t <= r.back().t);
+}
+
+// Truncated streams decode to a prefix; damaged ones never overrun
+static void test_corrupt() {
+    std::vector<Record> r = make_records(400, false);
+    std::vector<uint8_t> buf(4096);
+    size_t n = encode(r, buf, 8, true);
+    CHECK(n == r.size());
+
+    size_t last = 0;
+    for (size_t len = 0; len <= buf.size(); ++len) {
+        std::vector<uint8_t> cut(buf.begin(), buf.begin() + len);
+        bool same;
+        size_t got = decode(cut.data(), cut.size(), r, true, same);
+        CHECK(same && got >= last);
+        last = got;
+    }
+    CHECK(last == r.size());
+
+    for (int k = 0; k < 20000; ++k) {
+        std::vector<uint8_t> bad(buf);
+        for (int f = 1 + rand() % 4; f > 0; --f)
+            bad[rand() % bad.size()] ^= 1 << (rand() % 8);
+        bool same;
+        CHECK(decode(bad.data(), bad.size(), r, true, same) <= bad.size());
+        RTC_TimestampDecoder dec(bad.data(), bad.size());
+        uint32_t t;
+        dec.seek(rand());
+        for (size_t i = 0; i <= bad.size() && dec.next(t); ++i)
+            ;
+    }
+
+    // a varint longer than five bytes, and a damaged header
+    uint8_t over[] = { RTC_TS_MAGIC, RTC_TS_VERSION, 0, 8, 6, 0, 1, 2, 3, 4, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    RTC_TimestampDecoder dec(over, sizeof(over));
+    uint32_t t;
+    CHECK(dec.next(t) && t == 0x04030201UL);
+    CHECK(!dec.next(t));
+    over[1] = RTC_TS_VERSION + 1;
+    RTC_TimestampDecoder wrong(over, sizeof(over));
+    CHECK(!wrong.valid() && !wrong.next(t) && !wrong.seek(0));
+    RTC_TimestampDecoder empty(over, 2);
+    CHECK(!empty.valid() && !empty.next(t));
+}
+
+int main() {
+    srand(31);
+    test_round_trip();
+    test_full();
+    test_seek();
+    test_corrupt();
+    return host_report("test_timestamp_stream");
+}